@@ -1,14 +1,29 @@
+#include <stdlib.h>
 #include <string.h>
 #include <glib.h>
 #include "app.h"
+#include "ui_mailbox.h"
 
 void init_app_data(AppData *data)
 {
     memset(data, 0, sizeof(*data));
+    ui_mailbox_init(&data->mailbox);
+    g_mutex_init(&data->listener_lock);
+    g_mutex_init(&data->positions_lock);
+    listener_rotation_init(&data->listener);
+    listener_predictor_init(&data->predictor);
 
-    data->ports = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
-    data->links = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
-    data->nodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    flatmap_init(&data->ports, sizeof(PortInfo));
+    flatmap_init(&data->links, sizeof(LinkInfo));
+    flatmap_init(&data->nodes, sizeof(NodeInfo));
+    flatmap_init(&data->node_links, sizeof(uint32_t));
+    flatmap_init(&data->pending_links, sizeof(PendingLink));
+    flatmap_init(&data->ignored, sizeof(uint8_t));
+    flatmap_init(&data->link_ops, sizeof(LinkOp));
+    flatmap_init(&data->link_destroy_ops, sizeof(uint32_t));
+    flatmap_init(&data->link_retries, sizeof(LinkRetry));
+    strpool_init(&data->strings);
+    flatmap64_init(&data->port_index, sizeof(uint32_t));
 
     for (int i = 0; i < 8; i++) {
         data->filter_in_gid[i] = 0;
@@ -33,12 +48,37 @@ void init_app_data(AppData *data)
         data->sources[i].active = false;
         data->sources[i].is_playing = false;
         data->sources[i].initial_position_set = false;
-        data->sources[i].last_sofa_usec = 0;
-        data->sources[i].last_gain = 0.0f;
-        data->sources[i].last_azimuth = 0.0f;
-        data->sources[i].last_elevation = 0.0f;
-        data->sources[i].last_radius = 0.0f;
-        data->sources[i].last_width = 0.0f;
-        data->sources[i].last_valid = false;
     }
 }
+
+/* Frees the registry maps and shared state; the PipeWire side must already be shut down */
+void clear_app_data(AppData *data)
+{
+    flatmap_clear(&data->links);
+    flatmap_clear(&data->ports);
+    flatmap_clear(&data->nodes);
+    flatmap_clear(&data->node_links);
+    flatmap_clear(&data->pending_links);
+    flatmap_clear(&data->ignored);
+    flatmap_clear(&data->link_ops);
+    flatmap_clear(&data->link_destroy_ops);
+    flatmap_clear(&data->link_retries);
+    flatmap64_clear(&data->port_index);
+    strpool_clear(&data->strings);
+    ui_mailbox_clear(&data->mailbox);
+    g_mutex_clear(&data->listener_lock);
+    g_mutex_clear(&data->positions_lock);
+}
+
+#define CONTROL_RATE_HZ_DEFAULT 30
+
+/* Period of the control tick that pushes input to the filter (PW_MIXER_CONTROL_RATE_HZ) */
+gint64 control_period_from_env(void)
+{
+    const char *rate_s = g_getenv("PW_MIXER_CONTROL_RATE_HZ");
+    int rate = rate_s ? atoi(rate_s) : CONTROL_RATE_HZ_DEFAULT;
+
+    if (rate < 1 || rate > 1000)
+        rate = CONTROL_RATE_HZ_DEFAULT;
+    return G_USEC_PER_SEC / rate;
+}
@@ -1,9 +1,16 @@
 #ifndef PW_MIXER_APP_H
 #define PW_MIXER_APP_H
 
-#include <gtk/gtk.h>
+#include <glib.h>
 #include <pipewire/pipewire.h>
 #include <stdbool.h>
+#include "command_ring.h"
+#include "controls.h"
+#include "flatmap.h"
+#include "listener.h"
+#include "ramp.h"
+#include "sofa_grid.h"
+#include "strpool.h"
 
 #define MAX_SOURCES 4
 #define CANVAS_SIZE 400
@@ -13,17 +20,23 @@
 #define MIN_RADIUS_PCT 8.0f
 #define MAX_STEREO_SLOTS 4   /* 4 stereo sources → 8 inputs */
 
+typedef struct UiWidgets UiWidgets;
+typedef struct ControlSocket ControlSocket;
+typedef struct ShmState ShmState;
+typedef struct OscInput OscInput;
+
 typedef struct {
     bool occupied;
     uint32_t out_node_id;   /* node.id of the source (VLC, Spotify, etc.) */
 } StereoSlot;
 
+/* Strings are interned in AppData.strings; release them with strpool_release */
 typedef struct {
-    char *name;
-    char *desc;
-    char *app_name;
-    char *media_class;
-    char *icon_name;
+    const char *name;
+    const char *desc;
+    const char *app_name;
+    const char *media_class;
+    const char *icon_name;
 } NodeInfo;
 
 typedef struct {
@@ -33,12 +46,64 @@ typedef struct {
     int      port_id;        /* port.id within node (PW_KEY_PORT_ID) */
 } PortInfo;
 
+typedef enum {
+    LINK_OP_CREATE,
+    LINK_OP_DESTROY,
+} LinkOpType;
+
+/* One in-flight link create or destroy; a create's proxy listener lives in the proxy user data */
+typedef struct {
+    LinkOpType type;
+    uint32_t link_id;          /* destroy target, or the bound id of a create */
+    uint32_t out_port_gid;
+    uint32_t in_port_gid;
+    gint64 start_usec;
+    bool finished;             /* result is in; the proxy is released on the next sweep */
+    int result;                /* 0 or negative errno */
+    struct pw_proxy *proxy;    /* create only */
+} LinkOp;
+
+/* Outcome counts and completion latency per kind of link operation */
+typedef struct {
+    uint64_t issued;
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t timed_out;
+    uint64_t total_usec;
+    uint64_t max_usec;
+} LinkOpStats;
+
+/* Creates the reconciler issued for one source output; reset when the desired input changes */
+typedef struct {
+    uint32_t in_port_gid;
+    uint32_t attempts;         /* creates within LINK_RETRY_WINDOW_USEC of each other */
+    gint64 last_usec;          /* time of the last create */
+    bool gave_up;              /* left alone until the slot is reassigned or bypass toggles */
+} LinkRetry;
+
+/* Counters for the link reconciler; "kept" links are ones the old per-event logic would have recreated */
+typedef struct {
+    uint64_t requests;   /* reconcile requests, coalesced into passes */
+    uint64_t passes;
+    uint64_t kept;
+    uint64_t created;
+    uint64_t destroyed;
+} ReconcileStats;
+
+/* Link global seen before one of its ports; resolved when the port arrives or on core done */
+typedef struct {
+    uint32_t out_port_gid;
+    uint32_t in_port_gid;
+} PendingLink;
+
 typedef struct {
     uint32_t link_id;        /* registry global id of the Link object */
     uint32_t out_port_gid;   /* global id of output Port object */
     uint32_t in_port_gid;    /* global id of input Port object */
     uint32_t out_node_id;    /* node id owning the output port */
     int      filter_in_port_id; /* 0..7 if input is filter input, else -1 */
+    uint32_t node_prev;      /* previous/next link id from the same output node, 0 = none */
+    uint32_t node_next;
 } LinkInfo;
 
 typedef struct {
@@ -57,48 +122,163 @@ typedef struct {
     bool active;
     bool is_playing;
     bool initial_position_set;
-    gint64 last_sofa_usec;
-    float last_gain;
-    float last_azimuth;
-    float last_elevation;
-    float last_radius;
-    float last_width;
-    bool last_valid;
+    bool seed_from_filter;   /* adopted on warm start; position comes from the Props read-back */
 } AudioSource;
 
+enum {
+    UI_DIRTY_PLAYING      = 1 << 0,
+    UI_DIRTY_SOURCE_LABEL = 1 << 1,
+    UI_DIRTY_SENSITIVITY  = 1 << 2,
+    UI_DIRTY_POSITION     = 1 << 3,   /* moved by remote control; sliders follow */
+    UI_DIRTY_CANVAS       = 1 << 4,   /* what the canvas draws for the slot */
+};
+
+typedef struct {
+    char playing_text[160];
+    char source_text[64];
+    bool sliders_sensitive;
+    bool bypass_sensitive;
+    float elevation;
+    float width;
+    char app_label[128];
+    bool active;
+    bool playing;
+} UiSlotState;
+
+/* Widget state published by the PipeWire thread, applied on the GTK thread */
+typedef struct {
+    GMutex lock;
+    guint dirty[MAX_SOURCES];   /* UI_DIRTY_* per slot */
+    UiSlotState slots[MAX_SOURCES];
+    bool canvas_dirty;
+    gint scheduled;             /* idle flush pending */
+    GSourceFunc flush;
+    gpointer flush_data;
+} UiMailbox;
+
 typedef struct {
     struct pw_main_loop *loop;
     struct pw_context *context;
     struct pw_core *core;
     struct pw_registry *registry;
     struct pw_proxy *filter_proxy;
+    struct spa_hook filter_listener;   /* Props read-back into controls.shadow */
+    bool controls_synced;              /* first Props read-back seen */
 
-    GtkWidget *window;
-    GtkWidget *canvas;
-    GtkWidget *source_boxes[MAX_SOURCES];
-    GtkWidget *elevation_sliders[MAX_SOURCES];
-    GtkWidget *width_sliders[MAX_SOURCES];
-    GtkWidget *bypass_checkboxes[MAX_SOURCES];
-    GtkWidget *playing_labels[MAX_SOURCES];
-    GtkWidget *source_labels[MAX_SOURCES];
+    UiWidgets *ui;      /* GTK front end (ui.h); NULL in the headless daemon */
+    UiMailbox mailbox;
 
     AudioSource sources[MAX_SOURCES];
+    /* Guards sources[].azimuth/elevation/radius/width: the GTK input handlers and remote
+     * control (socket, shm, OSC) on the PipeWire thread both write them */
+    GMutex positions_lock;
     int active_source;
     uint32_t filter_node_id;
 
     struct spa_hook registry_listener;
     struct spa_hook core_listener;
+    GThread *pw_thread;         /* runs pipewire_thread(); commands posted from it apply in place */
+    ControlSocket *control_socket;
+    ShmState *shm_state;        /* shared-memory block, NULL unless PW_MIXER_SHM_NAME is set */
+    OscInput *osc_input;        /* OSC listener, NULL unless PW_MIXER_OSC_PORT is set */
+
+    /* Listener head orientation in degrees and the world -> head rotation built from it.
+     * Written by set_listener_orientation(), read by every control send; listener_lock guards both */
+    GMutex listener_lock;
+    float listener_yaw;
+    float listener_pitch;
+    float listener_roll;
+    ListenerRotation listener;
+
+    /* Motion-to-sound compensation (pw thread only): tracked poses feed the predictor
+     * and each send carries the pose expected once it is heard (PW_MIXER_PREDICT) */
+    bool predict_listener;
+    ListenerPredictor predictor;
+    gint64 props_sent_usec;        /* first Props update not yet read back, 0 when none */
+    int props_sync_seq;            /* core sync marking when the node has answered props_sync_gen */
+    uint32_t props_sync_gen;
+    uint32_t apply_usec;           /* running mean of Props send -> read-back */
+    uint32_t node_latency_usec;    /* filter node output Latency param */
+
+    /* GTK thread -> PipeWire thread commands, drained by command_event */
+    CommandRing commands;
+    struct spa_source *command_event;
 
-    GHashTable *ports; /* key: global port id (uint32), value: PortInfo* */
-    GHashTable *links; /* key: global link id (uint32), value: LinkInfo* */
-    GHashTable *nodes; /* key: global node id (uint32), value: NodeInfo* */
+    FlatMap ports;      /* key: global port id, value: PortInfo */
+    FlatMap links;      /* key: global link id, value: LinkInfo */
+    FlatMap nodes;      /* key: global node id, value: NodeInfo */
+    StrPool strings;    /* interned NodeInfo strings (pw thread only) */
+    FlatMap node_links; /* key: output node id, value: uint32 first link id of its LinkInfo list */
+    FlatMap pending_links; /* key: global link id, value: PendingLink */
+    FlatMap ignored;    /* key: id of an uninteresting node/port/link, value: uint8 IGNORED_* */
+
+    /* Link operations waiting for their result, swept by link_op_timer */
+    FlatMap link_ops;          /* key: operation id, value: LinkOp */
+    FlatMap link_destroy_ops;  /* key: link id being destroyed, value: uint32 operation id */
+    uint32_t next_link_op;
+    struct spa_source *link_op_timer;
+    bool link_op_timer_armed;
+    LinkOpStats link_create_stats;
+    LinkOpStats link_destroy_stats;
+    FlatMap link_retries;   /* key: output port gid, value: LinkRetry */
+    struct spa_source *link_retry_timer;  /* wakes the reconciler when a backoff ends */
+    gint64 link_retry_due;                /* when link_retry_timer fires, 0 when idle */
+    struct spa_source *seed_timer;        /* ends the wait for the read-back of adopted slots */
+    FlatMap64 port_index;   /* key: packed (node id, direction, port.id), value: uint32 global port id */
 
     /* Filter input port mapping: filter input "port.id" -> global port object id */
     uint32_t filter_in_gid[8];     /* index=port.id (0..7), value=global port id or 0 */
     bool     filter_in_occupied[8];
 
+    /* Pre-serialized filter controls, built when the filter node appears (pw thread only) */
+    ControlTable controls;
+
+    /* Control ramps, advanced by ramp_timer once per ramp_tick_usec (pw thread only) */
+    RampEngine ramps;
+    struct spa_source *ramp_timer;
+    bool ramp_timer_armed;
+    uint32_t ramp_tick_usec;     /* whole graph quanta, from the settings metadata */
+
+    /* "settings" metadata: clock.quantum / clock.rate and their force- overrides */
+    uint32_t settings_id;
+    struct pw_proxy *settings_proxy;
+    struct spa_hook settings_listener;
+    uint32_t clock_quantum, clock_rate;
+    uint32_t clock_force_quantum, clock_force_rate;
+
+    /* Cycle-aligned control groups: a port-less probe node marks each graph cycle
+     * and the queued group goes out as one Props update right after a cycle starts */
+    bool align_groups;
+    struct pw_filter *clock_probe;
+    struct spa_hook clock_probe_listener;
+    bool clock_probe_streaming;
+    bool clock_probe_active;         /* only while audio flows into the filter */
+    struct spa_source *cycle_event;
+    uint64_t cycle_count;            /* probe cycle stamps, written with atomics by the data thread */
+    uint64_t cycle_nsec, cycle_next_nsec;
+    uint32_t cycle_clock_id;         /* driver of the stamped cycle */
+    uint32_t filter_driver_id;       /* from the filter's node.driver-id, 0 when unknown */
+    char filter_group[128];          /* filter's node.group, copied onto the probe */
+    uint32_t cycle_wanted;           /* set by the pw thread, taken by the data thread */
+    float group_values[CTL_COUNT];
+    uint64_t group_mask;
+    uint64_t groups_sent, groups_straddled;
+
+    /* HRIR measurement grid of the configured SOFA file, read once in init_pipewire() */
+    SofaResolution sofa_resolution;
+    SofaGrid sofa_grid;
+
     bool initial_sync_done;
     uint32_t sync_seq;
+    int pending_sync_seq;      /* core sync issued for pending_links, 0 when none in flight */
+
+    /* Registry commit: events mark work, one pw_core_sync round applies it (commit_registry()) */
+    int commit_seq;            /* core sync the next commit waits for, 0 when idle */
+    uint32_t dirty_slots;      /* bit per slot whose connection state is re-evaluated */
+    bool reconcile_pending;    /* run reconcile_links() in the next commit */
+    bool reconcile_orphans;    /* scan for filter links from nodes without a slot */
+    bool reconcile_verify;     /* next pass only confirms the previous one */
+    ReconcileStats reconcile;
 
     StereoSlot stereo_slots[MAX_STEREO_SLOTS];
 
@@ -107,5 +287,7 @@ typedef struct {
 } AppData;
 
 void init_app_data(AppData *data);
+void clear_app_data(AppData *data);
+gint64 control_period_from_env(void);
 
 #endif /* PW_MIXER_APP_H */
@@ -0,0 +1,92 @@
+#include <string.h>
+#include "command_ring.h"
+
+#define RING_BYTES (COMMAND_RING_SIZE * sizeof(Command))
+
+bool command_ring_push(CommandRing *cr, const Command *cmd)
+{
+    uint32_t index;
+    int32_t filled = spa_ringbuffer_get_write_index(&cr->ring, &index);
+
+    if (filled < 0 || (uint32_t)filled + sizeof(Command) > RING_BYTES)
+        return false;
+
+    spa_ringbuffer_write_data(&cr->ring, cr->entries, RING_BYTES,
+                              index & (RING_BYTES - 1), cmd, sizeof(Command));
+    spa_ringbuffer_write_update(&cr->ring, index + sizeof(Command));
+    return true;
+}
+
+bool command_ring_pop(CommandRing *cr, Command *cmd)
+{
+    uint32_t index;
+    int32_t avail = spa_ringbuffer_get_read_index(&cr->ring, &index);
+
+    if (avail < (int32_t)sizeof(Command))
+        return false;
+
+    spa_ringbuffer_read_data(&cr->ring, cr->entries, RING_BYTES,
+                             index & (RING_BYTES - 1), cmd, sizeof(Command));
+    spa_ringbuffer_read_update(&cr->ring, index + sizeof(Command));
+    return true;
+}
+
+void command_ring_begin_controls(CommandRing *cr)
+{
+    uint64_t seq = __atomic_load_n(&cr->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&cr->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Only between command_ring_begin_controls() and command_ring_end_controls() */
+void command_ring_set_control(CommandRing *cr, uint32_t ctl, float value)
+{
+    uint32_t bits;
+
+    if (ctl >= CTL_COUNT)
+        return;
+
+    memcpy(&bits, &value, sizeof(bits));
+    __atomic_store_n(&cr->values[ctl], bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&cr->written[ctl], __atomic_load_n(&cr->seq, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void command_ring_end_controls(CommandRing *cr)
+{
+    uint64_t seq = __atomic_load_n(&cr->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&cr->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Returns a bit per control written since the last snapshot, or 0 while a
+ * batch is being written: the producer signals again once it is done.
+ */
+uint64_t command_ring_take_controls(CommandRing *cr, float values[CTL_COUNT])
+{
+    uint32_t bits[CTL_COUNT];
+    uint64_t written[CTL_COUNT];
+    uint64_t seq = __atomic_load_n(&cr->seq, __ATOMIC_ACQUIRE);
+
+    if (seq & 1 || seq == cr->taken_seq)
+        return 0;
+
+    for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++) {
+        bits[ctl] = __atomic_load_n(&cr->values[ctl], __ATOMIC_RELAXED);
+        written[ctl] = __atomic_load_n(&cr->written[ctl], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&cr->seq, __ATOMIC_RELAXED) != seq)
+        return 0;
+
+    uint64_t mask = 0;
+    for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++) {
+        if (written[ctl] <= cr->taken_seq)
+            continue;
+        memcpy(&values[ctl], &bits[ctl], sizeof(bits[ctl]));
+        mask |= UINT64_C(1) << ctl;
+    }
+    cr->taken_seq = seq;
+    return mask;
+}
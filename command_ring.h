@@ -0,0 +1,52 @@
+#ifndef PW_MIXER_COMMAND_RING_H
+#define PW_MIXER_COMMAND_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <spa/utils/ringbuffer.h>
+#include "controls.h"
+
+#define COMMAND_RING_SIZE 64   /* entries, power of two */
+
+typedef enum {
+    CMD_SET_BYPASS,
+    CMD_RELINK,
+    CMD_CLEANUP_LINKS,
+    CMD_ASSIGN_SLOT,     /* flag: stream node id, 0 empties the slot */
+} CommandType;
+
+typedef struct {
+    uint32_t type;       /* CommandType */
+    int32_t source_idx;
+    uint32_t flag;
+    uint32_t padding;    /* keeps the entry size a power of two */
+} Command;
+
+/*
+ * Single-producer (GTK thread) / single-consumer (PipeWire thread) queue.
+ * Discrete commands go through the ring in order; filter control values
+ * are latest-value cells so a newer value for a control replaces any value
+ * the PipeWire thread has not picked up yet.
+ *
+ * The cells are written a batch at a time under a seqlock: the consumer
+ * only takes a snapshot that no batch was being written during, so all
+ * controls of one batch reach the filter in the same Props update.
+ */
+typedef struct {
+    struct spa_ringbuffer ring;
+    Command entries[COMMAND_RING_SIZE];
+
+    uint64_t seq;                /* odd while a batch is being written */
+    uint32_t values[CTL_COUNT];  /* float bits, written with atomics */
+    uint64_t written[CTL_COUNT]; /* seq of the batch that last wrote each control */
+    uint64_t taken_seq;          /* newest snapshot taken (consumer only) */
+} CommandRing;
+
+bool command_ring_push(CommandRing *cr, const Command *cmd);
+bool command_ring_pop(CommandRing *cr, Command *cmd);
+void command_ring_begin_controls(CommandRing *cr);
+void command_ring_set_control(CommandRing *cr, uint32_t ctl, float value);
+void command_ring_end_controls(CommandRing *cr);
+uint64_t command_ring_take_controls(CommandRing *cr, float values[CTL_COUNT]);
+
+#endif /* PW_MIXER_COMMAND_RING_H */
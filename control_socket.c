@@ -0,0 +1,414 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <glib.h>
+#include <pipewire/pipewire.h>
+#include "control_socket.h"
+#include "mixer_protocol.h"
+#include "pipewire.h"
+#include "ui_mailbox.h"
+
+#define CONTROL_MAX_MESSAGE (sizeof(MixerMsgHeader) + MIXER_MAX_UPDATES * sizeof(MixerSourceUpdate))
+#define CONTROL_POSITION_FIELDS \
+    (MIXER_SET_AZIMUTH | MIXER_SET_ELEVATION | MIXER_SET_RADIUS | MIXER_SET_WIDTH)
+#define CONTROL_MAX_PENDING 64   /* replies waiting for the filter, per client */
+
+typedef struct ControlClient ControlClient;
+
+/* A reply held until the filter has answered the Props update that carries its request */
+typedef struct {
+    uint32_t seq;
+    int32_t status;
+    uint16_t applied;
+    uint32_t queue_usec;
+    uint32_t gen;                /* controls_handoff_gen() after the request was applied */
+    gint64 received;
+} PendingReply;
+
+struct ControlClient {
+    ControlSocket *server;
+    struct spa_source *source;
+    int fd;
+    size_t len;                  /* bytes of the current message read so far */
+    uint8_t buf[CONTROL_MAX_MESSAGE];
+    PendingReply pending[CONTROL_MAX_PENDING];   /* ring, oldest first; gens never decrease */
+    uint32_t pending_head, n_pending;
+    uint64_t requests;
+    uint64_t total_queue_usec;
+    uint32_t max_queue_usec;
+    uint64_t applies;            /* replies with a measured apply_usec */
+    uint64_t total_apply_usec;
+    uint32_t max_apply_usec;
+    ControlClient *next;
+};
+
+struct ControlSocket {
+    AppData *app;
+    struct pw_loop *loop;
+    struct spa_source *source;
+    char *path;
+    ControlClient *clients;
+};
+
+static char *control_socket_path(void)
+{
+    const char *path = g_getenv("PW_MIXER_CONTROL_SOCKET");
+    if (path)
+        return path[0] ? g_strdup(path) : NULL;   /* empty disables the socket */
+    return g_build_filename(g_get_user_runtime_dir(), MIXER_SOCKET_NAME, NULL);
+}
+
+static void client_close(ControlClient *client)
+{
+    ControlSocket *server = client->server;
+
+    for (ControlClient **p = &server->clients; *p; p = &(*p)->next) {
+        if (*p == client) {
+            *p = client->next;
+            break;
+        }
+    }
+
+    if (client->requests > 0)
+        printf("[ctl] client closed after %llu requests, queue mean %.1f us, max %u us\n",
+               (unsigned long long)client->requests,
+               (double)client->total_queue_usec / (double)client->requests, client->max_queue_usec);
+    if (client->applies > 0)
+        printf("[ctl] %llu requests answered by the filter, apply mean %.1f us, max %u us\n",
+               (unsigned long long)client->applies,
+               (double)client->total_apply_usec / (double)client->applies, client->max_apply_usec);
+
+    pw_loop_destroy_source(server->loop, client->source);
+    g_free(client);
+}
+
+static float clampf(float v, float lo, float hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+static bool update_is_valid(const MixerSourceUpdate *u)
+{
+    if (u->slot >= MAX_SOURCES)
+        return false;
+    if ((u->fields & MIXER_SET_AZIMUTH) && !isfinite(u->azimuth))
+        return false;
+    if ((u->fields & MIXER_SET_ELEVATION) && !isfinite(u->elevation))
+        return false;
+    if ((u->fields & MIXER_SET_RADIUS) && !isfinite(u->radius))
+        return false;
+    if ((u->fields & MIXER_SET_WIDTH) && !isfinite(u->width))
+        return false;
+    return true;
+}
+
+/*
+ * Applies a message's updates; position changes of all slots go out as one
+ * batch. Positions are written under positions_lock because the GTK thread
+ * writes and draws the same fields; the sliders learn the new values
+ * through the UI mailbox.
+ */
+uint16_t control_apply_updates(AppData *app, const MixerSourceUpdate *updates, uint16_t count)
+{
+    guint moved = 0;
+    uint16_t applied = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        const MixerSourceUpdate *u = &updates[i];
+        if (!update_is_valid(u))
+            continue;
+
+        AudioSource *src = &app->sources[u->slot];
+
+        if (u->fields & MIXER_SET_NODE)
+            assign_source_slot(app, u->slot, u->node_id);
+
+        g_mutex_lock(&app->positions_lock);
+        if (u->fields & MIXER_SET_AZIMUTH) {
+            float az = fmodf(u->azimuth, 360.0f);
+            src->azimuth = az < 0.0f ? az + 360.0f : az;
+        }
+        if (u->fields & MIXER_SET_ELEVATION)
+            src->elevation = clampf(u->elevation, -90.0f, 90.0f);
+        if (u->fields & MIXER_SET_RADIUS)
+            src->radius = clampf(u->radius, MIN_RADIUS_PCT, 100.0f);
+        if (u->fields & MIXER_SET_WIDTH)
+            src->width = clampf(u->width, 0.0f, 90.0f);
+        float elevation = src->elevation, width = src->width;
+        g_mutex_unlock(&app->positions_lock);
+
+        if (u->fields & (MIXER_SET_ELEVATION | MIXER_SET_WIDTH))
+            ui_mailbox_set_position(&app->mailbox, u->slot, elevation, width);
+        if (u->fields & CONTROL_POSITION_FIELDS)
+            moved |= 1u << u->slot;
+
+        if (u->fields & MIXER_SET_BYPASS)
+            set_source_bypass(app, u->slot, u->bypass != 0);
+
+        applied++;
+    }
+
+    if (moved)
+        send_sofa_controls(app, moved);
+    ui_mailbox_queue_redraw(&app->mailbox);
+    return applied;
+}
+
+/*
+ * queue_usec only covers the hand-off. apply_usec runs until the filter has
+ * answered the first Props update that carries the request, after the
+ * cycle-aligned group; a ramp continues past it. filter_usec is the
+ * running send -> read-back mean over all updates.
+ */
+static void send_reply(ControlClient *client, uint32_t seq, int32_t status,
+                       uint16_t applied, uint32_t queue_usec, uint32_t apply_usec)
+{
+    struct {
+        MixerMsgHeader header;
+        MixerReply reply;
+    } msg = {
+        .header = { .length = sizeof(MixerReply), .type = MIXER_MSG_REPLY, .count = 1, .seq = seq,
+                    .version = MIXER_PROTOCOL_VERSION },
+        .reply = { .seq = seq, .status = status, .applied = applied, .queue_usec = queue_usec,
+                   .filter_usec = client->server->app->apply_usec, .apply_usec = apply_usec },
+    };
+
+    /* Replies are tiny; a client that stops reading just misses them */
+    if (send(client->fd, &msg, sizeof(msg), MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)sizeof(msg))
+        fprintf(stderr, "[ctl] could not send reply %u: %s\n", seq, strerror(errno));
+}
+
+/* Sends the oldest held reply; measured is false when the filter will not answer for it */
+static void release_pending(ControlClient *client, bool measured)
+{
+    const PendingReply *p = &client->pending[client->pending_head];
+    uint32_t apply_usec = 0;
+
+    if (measured) {
+        apply_usec = (uint32_t)(g_get_monotonic_time() - p->received);
+        client->applies++;
+        client->total_apply_usec += apply_usec;
+        if (apply_usec > client->max_apply_usec)
+            client->max_apply_usec = apply_usec;
+    }
+    send_reply(client, p->seq, p->status, p->applied, p->queue_usec, apply_usec);
+    client->pending_head = (client->pending_head + 1) % CONTROL_MAX_PENDING;
+    client->n_pending--;
+}
+
+/* Replies go out in request order, each once the filter has answered its generation */
+static void release_synced(ControlClient *client)
+{
+    AppData *app = client->server->app;
+
+    while (client->n_pending > 0) {
+        if (!app->filter_proxy)
+            release_pending(client, false);
+        else if (client->pending[client->pending_head].gen <= app->controls.synced_gen)
+            release_pending(client, true);
+        else
+            break;
+    }
+}
+
+static void handle_message(ControlClient *client, gint64 received)
+{
+    const MixerMsgHeader *header = (const MixerMsgHeader *)client->buf;
+    const MixerSourceUpdate *updates = (const MixerSourceUpdate *)(client->buf + sizeof(*header));
+    AppData *app = client->server->app;
+
+    if (header->type != MIXER_MSG_UPDATE ||
+        header->length != header->count * sizeof(MixerSourceUpdate)) {
+        /* Keeps replies in order behind the ones still waiting */
+        while (client->n_pending > 0)
+            release_pending(client, false);
+        send_reply(client, header->seq, -EPROTO, 0, 0, 0);
+        return;
+    }
+
+    uint16_t applied = control_apply_updates(app, updates, header->count);
+    uint32_t queue_usec = (uint32_t)(g_get_monotonic_time() - received);
+
+    client->requests++;
+    client->total_queue_usec += queue_usec;
+    if (queue_usec > client->max_queue_usec)
+        client->max_queue_usec = queue_usec;
+
+    /* A client that pipelines past the ring gets its oldest reply unmeasured */
+    if (client->n_pending == CONTROL_MAX_PENDING)
+        release_pending(client, false);
+
+    PendingReply *p = &client->pending[(client->pending_head + client->n_pending) % CONTROL_MAX_PENDING];
+    *p = (PendingReply) {
+        .seq = header->seq,
+        .status = applied == header->count ? 0 : -EINVAL,
+        .applied = applied,
+        .queue_usec = queue_usec,
+        .gen = controls_handoff_gen(app),
+        .received = received,
+    };
+    client->n_pending++;
+    release_synced(client);
+}
+
+void control_socket_synced(ControlSocket *server)
+{
+    if (!server)
+        return;
+
+    for (ControlClient *client = server->clients; client; client = client->next)
+        release_synced(client);
+}
+
+static void on_client_io(void *data, int fd, uint32_t mask)
+{
+    ControlClient *client = data;
+
+    for (;;) {
+        size_t want = sizeof(MixerMsgHeader);
+        if (client->len >= want) {
+            const MixerMsgHeader *header = (const MixerMsgHeader *)client->buf;
+            /* Another version may frame messages differently; nothing after this header can be trusted */
+            if (header->version != MIXER_PROTOCOL_VERSION) {
+                fprintf(stderr, "[ctl] client speaks protocol %u, expected %u; closing\n",
+                        header->version, MIXER_PROTOCOL_VERSION);
+                send_reply(client, header->seq, -EPROTONOSUPPORT, 0, 0, 0);
+                client_close(client);
+                return;
+            }
+            if (header->length > CONTROL_MAX_MESSAGE - sizeof(*header)) {
+                send_reply(client, header->seq, -EMSGSIZE, 0, 0, 0);
+                client_close(client);
+                return;
+            }
+            want += header->length;
+        }
+
+        if (client->len == want) {
+            /* Latency is counted from the moment the whole message is in */
+            handle_message(client, g_get_monotonic_time());
+            client->len = 0;
+            continue;
+        }
+
+        ssize_t n = read(fd, client->buf + client->len, want - client->len);
+        if (n > 0) {
+            client->len += (size_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR) && !(mask & (SPA_IO_HUP | SPA_IO_ERR)))
+            return;
+
+        client_close(client);
+        return;
+    }
+}
+
+static void on_accept(void *data, int fd, uint32_t mask)
+{
+    (void)mask;
+    ControlSocket *server = data;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                fprintf(stderr, "[ctl] accept failed: %s\n", strerror(errno));
+            return;
+        }
+
+        ControlClient *client = g_new0(ControlClient, 1);
+        client->server = server;
+        client->fd = client_fd;
+        client->source = pw_loop_add_io(server->loop, client_fd, SPA_IO_IN | SPA_IO_HUP | SPA_IO_ERR,
+                                        true, on_client_io, client);
+        if (!client->source) {
+            close(client_fd);
+            g_free(client);
+            continue;
+        }
+        client->next = server->clients;
+        server->clients = client;
+    }
+}
+
+/* Removes a socket file left by a previous run, but never one that is still served */
+static bool socket_path_is_live(const struct sockaddr_un *addr)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    bool live = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    close(fd);
+    if (!live)
+        unlink(addr->sun_path);
+    return live;
+}
+
+ControlSocket *control_socket_start(AppData *app)
+{
+    char *path = control_socket_path();
+    if (!path)
+        return NULL;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[ctl] socket path too long: %s\n", path);
+        g_free(path);
+        return NULL;
+    }
+    g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+    if (socket_path_is_live(&addr)) {
+        fprintf(stderr, "[ctl] %s is in use by another instance; control socket disabled\n", path);
+        g_free(path);
+        return NULL;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        chmod(path, 0600) < 0 || listen(fd, 8) < 0) {
+        fprintf(stderr, "[ctl] cannot listen on %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        g_free(path);
+        return NULL;
+    }
+
+    ControlSocket *server = g_new0(ControlSocket, 1);
+    server->app = app;
+    server->loop = pw_main_loop_get_loop(app->loop);
+    server->path = path;
+    server->source = pw_loop_add_io(server->loop, fd, SPA_IO_IN, true, on_accept, server);
+    if (!server->source) {
+        close(fd);
+        unlink(path);
+        g_free(path);
+        g_free(server);
+        return NULL;
+    }
+
+    printf("[ctl] control socket at %s\n", path);
+    return server;
+}
+
+void control_socket_stop(ControlSocket *server)
+{
+    if (!server)
+        return;
+
+    while (server->clients)
+        client_close(server->clients);
+
+    pw_loop_destroy_source(server->loop, server->source);
+    unlink(server->path);
+    g_free(server->path);
+    g_free(server);
+}
@@ -0,0 +1,21 @@
+#ifndef PW_MIXER_CONTROL_SOCKET_H
+#define PW_MIXER_CONTROL_SOCKET_H
+
+#include "app.h"
+#include "mixer_protocol.h"
+
+/*
+ * Unix socket control API (mixer_protocol.h), served on the PipeWire
+ * loop. Updates go through the same send_sofa_controls() /
+ * set_source_bypass() / assign_source_slot() paths as the GUI.
+ */
+ControlSocket *control_socket_start(AppData *app);
+void control_socket_stop(ControlSocket *server);
+
+/* Sends the replies whose Props update the filter has answered; call after control_shadow_synced() */
+void control_socket_synced(ControlSocket *server);
+
+/* Shared by every external input (socket, shared-memory block); pw thread only */
+uint16_t control_apply_updates(AppData *app, const MixerSourceUpdate *updates, uint16_t count);
+
+#endif /* PW_MIXER_CONTROL_SOCKET_H */
@@ -0,0 +1,145 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <spa/pod/builder.h>
+#include "controls.h"
+
+static const char *const spk_param_names[CTL_PARAMS_PER_SPK] = {
+    "Azimuth", "Elevation", "Radius", "Bypass",
+};
+
+static void control_build(FilterControl *c, const char *name)
+{
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(c->pod, sizeof(c->pod));
+
+    g_strlcpy(c->name, name, sizeof(c->name));
+    spa_pod_builder_string(&b, name);
+    c->value_offset = b.state.offset + sizeof(struct spa_pod);
+    spa_pod_builder_float(&b, 0.0f);
+    c->size = b.state.offset;
+}
+
+void control_table_build(ControlTable *table)
+{
+    char name[24];
+
+    for (int spk = 0; spk < CTL_SPK_COUNT; spk++) {
+        for (int p = 0; p < CTL_PARAMS_PER_SPK; p++) {
+            snprintf(name, sizeof(name), "spk%d:%s", spk + 1, spk_param_names[p]);
+            control_build(&table->controls[ctl_spk(spk, p)], name);
+        }
+    }
+
+    for (int ch = 0; ch < CTL_SPK_COUNT; ch++) {
+        snprintf(name, sizeof(name), "mixL:Gain %d", ch + 1);
+        control_build(&table->controls[ctl_gain(CTL_MIX_L, ch)], name);
+        snprintf(name, sizeof(name), "mixR:Gain %d", ch + 1);
+        control_build(&table->controls[ctl_gain(CTL_MIX_R, ch)], name);
+    }
+
+    memset(table->shadow, 0, sizeof(table->shadow));
+    table->send_gen = 0;
+    table->synced_gen = 0;
+    table->ready = true;
+}
+
+void control_table_clear(ControlTable *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+const FilterControl *control_table_patch(ControlTable *table, uint32_t ctl, float value)
+{
+    if (!table->ready || ctl >= CTL_COUNT)
+        return NULL;
+
+    FilterControl *c = &table->controls[ctl];
+    memcpy(c->pod + c->value_offset, &value, sizeof(value));
+    return c;
+}
+
+int control_table_find(const ControlTable *table, const char *name)
+{
+    if (!table->ready || !name)
+        return -1;
+
+    for (int i = 0; i < CTL_COUNT; i++) {
+        if (strcmp(table->controls[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Smallest change worth sending; matches the old whole-source deadband */
+static float control_tolerance(uint32_t ctl)
+{
+    if (ctl >= CTL_GAIN_BASE)
+        return 0.005f;
+    if (ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_BYPASS)
+        return 0.5f;
+    return 0.25f;
+}
+
+/* The value the node holds or is about to hold; false when unknown */
+bool control_shadow_value(const ControlTable *table, uint32_t ctl, float *value)
+{
+    if (ctl >= CTL_COUNT)
+        return false;
+
+    const ControlShadow *sh = &table->shadow[ctl];
+    bool answered = sh->sent_gen <= table->synced_gen;
+
+    if (sh->reported_valid && answered && sh->reported_gen >= sh->sent_gen)
+        *value = sh->reported;
+    else if (sh->sent_gen)
+        *value = sh->sent;      /* not answered yet, or no report since it was */
+    else
+        return false;
+    return true;
+}
+
+bool control_shadow_needs(const ControlTable *table, uint32_t ctl, float value)
+{
+    float ref;
+
+    if (ctl >= CTL_COUNT)
+        return false;
+    if (!control_shadow_value(table, ctl, &ref))
+        return true;
+    return fabsf(value - ref) > control_tolerance(ctl);
+}
+
+/* Stamps the value with the Props update being built; control_shadow_commit() closes it */
+void control_shadow_sent(ControlTable *table, uint32_t ctl, float value)
+{
+    if (ctl >= CTL_COUNT)
+        return;
+
+    table->shadow[ctl].sent = value;
+    table->shadow[ctl].sent_gen = table->send_gen + 1;
+}
+
+/* Returns the generation of the Props update that was just sent */
+uint32_t control_shadow_commit(ControlTable *table)
+{
+    return ++table->send_gen;
+}
+
+/* The node has processed every Props update up to gen */
+void control_shadow_synced(ControlTable *table, uint32_t gen)
+{
+    if (gen > table->synced_gen)
+        table->synced_gen = gen;
+}
+
+void control_shadow_report(ControlTable *table, uint32_t ctl, float value)
+{
+    if (ctl >= CTL_COUNT)
+        return;
+
+    ControlShadow *sh = &table->shadow[ctl];
+    sh->reported = value;
+    sh->reported_gen = table->send_gen;
+    sh->reported_valid = true;
+}
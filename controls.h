@@ -0,0 +1,79 @@
+#ifndef PW_MIXER_CONTROLS_H
+#define PW_MIXER_CONTROLS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CTL_SPK_COUNT 8      /* spk1..spk8 in the filter graph */
+
+enum {
+    CTL_PARAM_AZIMUTH,
+    CTL_PARAM_ELEVATION,
+    CTL_PARAM_RADIUS,
+    CTL_PARAM_BYPASS,
+    CTL_PARAMS_PER_SPK,
+};
+
+enum {
+    CTL_MIX_L,
+    CTL_MIX_R,
+    CTL_MIX_SIDES,
+};
+
+#define CTL_GAIN_BASE (CTL_SPK_COUNT * CTL_PARAMS_PER_SPK)
+#define CTL_COUNT (CTL_GAIN_BASE + CTL_MIX_SIDES * CTL_SPK_COUNT)
+
+typedef struct {
+    char name[24];          /* e.g. "spk3:Azimuth", "mixR:Gain 5" */
+    uint8_t pod[48];        /* pre-serialized String name + Float value */
+    uint32_t size;          /* bytes used in pod, 8-byte padded */
+    uint32_t value_offset;  /* offset of the float payload inside pod */
+} FilterControl;
+
+/*
+ * What the filter node holds for one control, kept current from its Props
+ * events. Sends and reports are ordered by generation: a send stays the
+ * reference until the node has answered it, then the newest report that
+ * arrived after it wins, whatever value the node chose to hold.
+ */
+typedef struct {
+    float reported;         /* last value read back from the node */
+    float sent;             /* last value sent */
+    uint32_t sent_gen;      /* Props update that carried sent, 0 before any */
+    uint32_t reported_gen;  /* Props updates sent before reported arrived */
+    bool reported_valid;
+} ControlShadow;
+
+typedef struct {
+    bool ready;
+    uint32_t send_gen;      /* Props updates sent */
+    uint32_t synced_gen;    /* newest Props update the node has answered */
+    FilterControl controls[CTL_COUNT];
+    ControlShadow shadow[CTL_COUNT];
+} ControlTable;
+
+/* spk: 0..7 (spk1..spk8), param: CTL_PARAM_* */
+static inline uint32_t ctl_spk(int spk, int param)
+{
+    return (uint32_t)(spk * CTL_PARAMS_PER_SPK + param);
+}
+
+/* side: CTL_MIX_L/CTL_MIX_R, channel: 0..7 (Gain 1..Gain 8) */
+static inline uint32_t ctl_gain(int side, int channel)
+{
+    return (uint32_t)(CTL_GAIN_BASE + side * CTL_SPK_COUNT + channel);
+}
+
+void control_table_build(ControlTable *table);
+void control_table_clear(ControlTable *table);
+const FilterControl *control_table_patch(ControlTable *table, uint32_t ctl, float value);
+int control_table_find(const ControlTable *table, const char *name);
+
+bool control_shadow_needs(const ControlTable *table, uint32_t ctl, float value);
+bool control_shadow_value(const ControlTable *table, uint32_t ctl, float *value);
+void control_shadow_sent(ControlTable *table, uint32_t ctl, float value);
+uint32_t control_shadow_commit(ControlTable *table);
+void control_shadow_synced(ControlTable *table, uint32_t gen);
+void control_shadow_report(ControlTable *table, uint32_t ctl, float value);
+
+#endif /* PW_MIXER_CONTROLS_H */
@@ -0,0 +1,49 @@
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <pipewire/pipewire.h>
+#include "app.h"
+#include "pipewire.h"
+
+/*
+ * pw-3d-mixerd: the link manager and filter controls without GTK. The
+ * PipeWire loop runs on the main thread; slot allocation, bypass and
+ * positions follow the same rules as the GUI build.
+ */
+
+static void on_quit_signal(void *user_data, int signal_number)
+{
+    AppData *data = user_data;
+    printf("[daemon] signal %d, shutting down\n", signal_number);
+    pw_main_loop_quit(data->loop);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    AppData data;
+    init_app_data(&data);
+
+    if (!init_pipewire(&data)) {
+        return 1;
+    }
+
+    struct pw_loop *loop = pw_main_loop_get_loop(data.loop);
+    struct spa_source *sigint = pw_loop_add_signal(loop, SIGINT, on_quit_signal, &data);
+    struct spa_source *sigterm = pw_loop_add_signal(loop, SIGTERM, on_quit_signal, &data);
+
+    printf("[daemon] running headless\n");
+    pipewire_thread(&data);
+
+    /* The loop is destroyed by shutdown_pipewire(); its sources go first */
+    if (sigint)
+        pw_loop_destroy_source(loop, sigint);
+    if (sigterm)
+        pw_loop_destroy_source(loop, sigterm);
+    shutdown_pipewire(&data);
+    clear_app_data(&data);
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <string.h>
+#include <glib.h>
+#include "flatmap.h"
+
+#define FLATMAP_MIN_CAPACITY 64
+
+static inline uint32_t bucket_of(const FlatMap *map, uint32_t key)
+{
+    /* Fibonacci hashing spreads the mostly sequential registry ids */
+    return (uint32_t)(key * 0x9E3779B1u) >> map->shift;
+}
+
+static inline void *value_at(const FlatMap *map, uint32_t pos)
+{
+    return map->values + (size_t)pos * map->value_size;
+}
+
+static void alloc_buckets(FlatMap *map, uint32_t capacity)
+{
+    map->capacity = capacity;
+    map->shift = 32 - (uint32_t)__builtin_ctz(capacity);
+    map->keys = g_new(uint32_t, capacity);
+    memset(map->keys, 0xff, (size_t)capacity * sizeof(uint32_t));
+    map->values = g_malloc0((size_t)capacity * map->value_size);
+    map->count = 0;
+}
+
+static void grow(FlatMap *map)
+{
+    uint32_t old_capacity = map->capacity;
+    uint32_t *old_keys = map->keys;
+    uint8_t *old_values = map->values;
+
+    alloc_buckets(map, old_capacity ? old_capacity * 2 : FLATMAP_MIN_CAPACITY);
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] == FLATMAP_EMPTY)
+            continue;
+        void *dst = flatmap_insert(map, old_keys[i]);
+        memcpy(dst, old_values + (size_t)i * map->value_size, map->value_size);
+    }
+
+    g_free(old_keys);
+    g_free(old_values);
+}
+
+void flatmap_init(FlatMap *map, size_t value_size)
+{
+    memset(map, 0, sizeof(*map));
+    map->value_size = value_size;
+}
+
+void flatmap_clear(FlatMap *map)
+{
+    g_free(map->keys);
+    g_free(map->values);
+    flatmap_init(map, map->value_size);
+}
+
+void *flatmap_lookup(const FlatMap *map, uint32_t key)
+{
+    if (map->count == 0 || key == FLATMAP_EMPTY)
+        return NULL;
+
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t pos = bucket_of(map, key);; pos = (pos + 1) & mask) {
+        if (map->keys[pos] == key)
+            return value_at(map, pos);
+        if (map->keys[pos] == FLATMAP_EMPTY)
+            return NULL;
+    }
+}
+
+void *flatmap_insert(FlatMap *map, uint32_t key)
+{
+    if (key == FLATMAP_EMPTY)
+        return NULL;
+
+    /* Keep the load factor at or below 3/4 */
+    if ((map->count + 1) * 4 > map->capacity * 3)
+        grow(map);
+
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t pos = bucket_of(map, key);; pos = (pos + 1) & mask) {
+        if (map->keys[pos] == key)
+            return value_at(map, pos);
+        if (map->keys[pos] == FLATMAP_EMPTY) {
+            map->keys[pos] = key;
+            map->count++;
+            void *value = value_at(map, pos);
+            memset(value, 0, map->value_size);
+            return value;
+        }
+    }
+}
+
+bool flatmap_remove(FlatMap *map, uint32_t key)
+{
+    if (map->count == 0 || key == FLATMAP_EMPTY)
+        return false;
+
+    uint32_t mask = map->capacity - 1;
+    uint32_t pos = bucket_of(map, key);
+    while (map->keys[pos] != key) {
+        if (map->keys[pos] == FLATMAP_EMPTY)
+            return false;
+        pos = (pos + 1) & mask;
+    }
+
+    /* Backward-shift the rest of the probe run into the hole */
+    uint32_t hole = pos;
+    for (uint32_t next = (hole + 1) & mask; map->keys[next] != FLATMAP_EMPTY; next = (next + 1) & mask) {
+        uint32_t home = bucket_of(map, map->keys[next]);
+        /* Move only if the hole lies on the probe path from home to next */
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            memcpy(value_at(map, hole), value_at(map, next), map->value_size);
+            hole = next;
+        }
+    }
+
+    map->keys[hole] = FLATMAP_EMPTY;
+    map->count--;
+    return true;
+}
+
+size_t flatmap_memory(const FlatMap *map)
+{
+    return (size_t)map->capacity * (sizeof(uint32_t) + map->value_size);
+}
+
+void flatmap_iter_init(FlatMapIter *iter, const FlatMap *map)
+{
+    iter->map = map;
+    iter->pos = 0;
+}
+
+bool flatmap_iter_next(FlatMapIter *iter, uint32_t *key, void **value)
+{
+    const FlatMap *map = iter->map;
+
+    while (iter->pos < map->capacity) {
+        uint32_t pos = iter->pos++;
+        if (map->keys[pos] == FLATMAP_EMPTY)
+            continue;
+        if (key)
+            *key = map->keys[pos];
+        if (value)
+            *value = value_at(map, pos);
+        return true;
+    }
+    return false;
+}
+
+/* FlatMap64: identical layout and probing, 64-bit keys */
+
+static inline uint32_t bucket64_of(const FlatMap64 *map, uint64_t key)
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> map->shift);
+}
+
+static inline void *value64_at(const FlatMap64 *map, uint32_t pos)
+{
+    return map->values + (size_t)pos * map->value_size;
+}
+
+static void alloc_buckets64(FlatMap64 *map, uint32_t capacity)
+{
+    map->capacity = capacity;
+    map->shift = 64 - (uint32_t)__builtin_ctz(capacity);
+    map->keys = g_new(uint64_t, capacity);
+    memset(map->keys, 0xff, (size_t)capacity * sizeof(uint64_t));
+    map->values = g_malloc0((size_t)capacity * map->value_size);
+    map->count = 0;
+}
+
+static void grow64(FlatMap64 *map)
+{
+    uint32_t old_capacity = map->capacity;
+    uint64_t *old_keys = map->keys;
+    uint8_t *old_values = map->values;
+
+    alloc_buckets64(map, old_capacity ? old_capacity * 2 : FLATMAP_MIN_CAPACITY);
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] == FLATMAP64_EMPTY)
+            continue;
+        void *dst = flatmap64_insert(map, old_keys[i]);
+        memcpy(dst, old_values + (size_t)i * map->value_size, map->value_size);
+    }
+
+    g_free(old_keys);
+    g_free(old_values);
+}
+
+void flatmap64_init(FlatMap64 *map, size_t value_size)
+{
+    memset(map, 0, sizeof(*map));
+    map->value_size = value_size;
+}
+
+void flatmap64_clear(FlatMap64 *map)
+{
+    g_free(map->keys);
+    g_free(map->values);
+    flatmap64_init(map, map->value_size);
+}
+
+void *flatmap64_lookup(const FlatMap64 *map, uint64_t key)
+{
+    if (map->count == 0 || key == FLATMAP64_EMPTY)
+        return NULL;
+
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t pos = bucket64_of(map, key);; pos = (pos + 1) & mask) {
+        if (map->keys[pos] == key)
+            return value64_at(map, pos);
+        if (map->keys[pos] == FLATMAP64_EMPTY)
+            return NULL;
+    }
+}
+
+void *flatmap64_insert(FlatMap64 *map, uint64_t key)
+{
+    if (key == FLATMAP64_EMPTY)
+        return NULL;
+
+    if ((map->count + 1) * 4 > map->capacity * 3)
+        grow64(map);
+
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t pos = bucket64_of(map, key);; pos = (pos + 1) & mask) {
+        if (map->keys[pos] == key)
+            return value64_at(map, pos);
+        if (map->keys[pos] == FLATMAP64_EMPTY) {
+            map->keys[pos] = key;
+            map->count++;
+            void *value = value64_at(map, pos);
+            memset(value, 0, map->value_size);
+            return value;
+        }
+    }
+}
+
+bool flatmap64_remove(FlatMap64 *map, uint64_t key)
+{
+    if (map->count == 0 || key == FLATMAP64_EMPTY)
+        return false;
+
+    uint32_t mask = map->capacity - 1;
+    uint32_t pos = bucket64_of(map, key);
+    while (map->keys[pos] != key) {
+        if (map->keys[pos] == FLATMAP64_EMPTY)
+            return false;
+        pos = (pos + 1) & mask;
+    }
+
+    uint32_t hole = pos;
+    for (uint32_t next = (hole + 1) & mask; map->keys[next] != FLATMAP64_EMPTY; next = (next + 1) & mask) {
+        uint32_t home = bucket64_of(map, map->keys[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            memcpy(value64_at(map, hole), value64_at(map, next), map->value_size);
+            hole = next;
+        }
+    }
+
+    map->keys[hole] = FLATMAP64_EMPTY;
+    map->count--;
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef PW_MIXER_FLATMAP_H
+#define PW_MIXER_FLATMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLATMAP_EMPTY UINT32_MAX   /* never a valid registry id (SPA_ID_INVALID) */
+
+/*
+ * Open-addressing hash map from uint32 registry ids to fixed-size values
+ * stored inline. Linear probing with backward-shift deletion, so there are
+ * no tombstones. Value pointers stay valid only until the next insert or
+ * remove on the same map.
+ */
+typedef struct {
+    uint32_t *keys;
+    uint8_t *values;
+    size_t value_size;
+    uint32_t capacity;   /* power of two, 0 before the first insert */
+    uint32_t count;
+    uint32_t shift;      /* 32 - log2(capacity) */
+} FlatMap;
+
+typedef struct {
+    const FlatMap *map;
+    uint32_t pos;
+} FlatMapIter;
+
+void flatmap_init(FlatMap *map, size_t value_size);
+void flatmap_clear(FlatMap *map);
+void *flatmap_lookup(const FlatMap *map, uint32_t key);
+void *flatmap_insert(FlatMap *map, uint32_t key);
+bool flatmap_remove(FlatMap *map, uint32_t key);
+size_t flatmap_memory(const FlatMap *map);
+
+static inline uint32_t flatmap_count(const FlatMap *map)
+{
+    return map->count;
+}
+
+void flatmap_iter_init(FlatMapIter *iter, const FlatMap *map);
+bool flatmap_iter_next(FlatMapIter *iter, uint32_t *key, void **value);
+
+#define FLATMAP64_EMPTY UINT64_MAX
+
+/* The same map for composite uint64 keys, e.g. packed (node, direction, port) */
+typedef struct {
+    uint64_t *keys;
+    uint8_t *values;
+    size_t value_size;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t shift;      /* 64 - log2(capacity) */
+} FlatMap64;
+
+void flatmap64_init(FlatMap64 *map, size_t value_size);
+void flatmap64_clear(FlatMap64 *map);
+void *flatmap64_lookup(const FlatMap64 *map, uint64_t key);
+void *flatmap64_insert(FlatMap64 *map, uint64_t key);
+bool flatmap64_remove(FlatMap64 *map, uint64_t key);
+
+#endif /* PW_MIXER_FLATMAP_H */
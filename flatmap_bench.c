@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "flatmap.h"
+
+/*
+ * Compares the GHashTable + g_new0 value layout the registry maps used to
+ * have with FlatMap storing PortInfo inline. Registry ids are handed out
+ * mostly in sequence with gaps, so the keys follow the same pattern.
+ *
+ *   meson compile -C build flatmap-bench && ./build/flatmap-bench
+ */
+
+#define LOOKUP_ROUNDS 10
+
+/* Same layout as PortInfo in app.h, without pulling in GTK/PipeWire */
+typedef struct {
+    uint32_t global_id;
+    uint32_t node_id;
+    int direction;
+    int port_id;
+} PortInfo;
+
+/* Large tables are served by mmap and show up in hblkhd, not uordblks */
+static size_t heap_in_use(void)
+{
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+static uint32_t *make_ids(uint32_t n)
+{
+    uint32_t *ids = g_new(uint32_t, n);
+    uint32_t id = 40;
+
+    for (uint32_t i = 0; i < n; i++) {
+        id += 1 + (uint32_t)g_random_int_range(0, 4);
+        ids[i] = id;
+    }
+    return ids;
+}
+
+static double elapsed_ms(gint64 start)
+{
+    return (double)(g_get_monotonic_time() - start) / 1000.0;
+}
+
+static void bench_ghashtable(const uint32_t *ids, uint32_t n)
+{
+    size_t heap_before = heap_in_use();
+    gint64 t = g_get_monotonic_time();
+
+    GHashTable *ports = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    for (uint32_t i = 0; i < n; i++) {
+        PortInfo *pi = g_new0(PortInfo, 1);
+        pi->global_id = ids[i];
+        pi->node_id = ids[i] / 8;
+        g_hash_table_replace(ports, GUINT_TO_POINTER(ids[i]), pi);
+    }
+    double insert_ms = elapsed_ms(t);
+    size_t heap = heap_in_use() - heap_before;
+
+    t = g_get_monotonic_time();
+    uint64_t sum = 0;
+    for (int r = 0; r < LOOKUP_ROUNDS; r++) {
+        for (uint32_t i = 0; i < n; i++) {
+            PortInfo *pi = g_hash_table_lookup(ports, GUINT_TO_POINTER(ids[i]));
+            sum += pi->node_id;
+        }
+    }
+    double lookup_ms = elapsed_ms(t);
+
+    t = g_get_monotonic_time();
+    for (uint32_t i = 0; i < n; i++)
+        g_hash_table_remove(ports, GUINT_TO_POINTER(ids[i]));
+    double remove_ms = elapsed_ms(t);
+    g_hash_table_destroy(ports);
+
+    printf("  GHashTable  insert %8.2f ms  lookup x%d %8.2f ms  remove %8.2f ms  heap %9zu B  (%llu)\n",
+           insert_ms, LOOKUP_ROUNDS, lookup_ms, remove_ms, heap, (unsigned long long)sum);
+}
+
+static void bench_flatmap(const uint32_t *ids, uint32_t n)
+{
+    size_t heap_before = heap_in_use();
+    gint64 t = g_get_monotonic_time();
+
+    FlatMap ports;
+    flatmap_init(&ports, sizeof(PortInfo));
+    for (uint32_t i = 0; i < n; i++) {
+        PortInfo *pi = flatmap_insert(&ports, ids[i]);
+        pi->global_id = ids[i];
+        pi->node_id = ids[i] / 8;
+    }
+    double insert_ms = elapsed_ms(t);
+    size_t heap = heap_in_use() - heap_before;
+
+    t = g_get_monotonic_time();
+    uint64_t sum = 0;
+    for (int r = 0; r < LOOKUP_ROUNDS; r++) {
+        for (uint32_t i = 0; i < n; i++) {
+            PortInfo *pi = flatmap_lookup(&ports, ids[i]);
+            sum += pi->node_id;
+        }
+    }
+    double lookup_ms = elapsed_ms(t);
+
+    t = g_get_monotonic_time();
+    for (uint32_t i = 0; i < n; i++)
+        flatmap_remove(&ports, ids[i]);
+    double remove_ms = elapsed_ms(t);
+    flatmap_clear(&ports);
+
+    printf("  FlatMap     insert %8.2f ms  lookup x%d %8.2f ms  remove %8.2f ms  heap %9zu B  (%llu)\n",
+           insert_ms, LOOKUP_ROUNDS, lookup_ms, remove_ms, heap, (unsigned long long)sum);
+}
+
+int main(void)
+{
+    static const uint32_t sizes[] = {1000, 10000, 100000};
+
+    for (size_t s = 0; s < G_N_ELEMENTS(sizes); s++) {
+        uint32_t *ids = make_ids(sizes[s]);
+
+        printf("%u globals\n", sizes[s]);
+        bench_ghashtable(ids, sizes[s]);
+        bench_flatmap(ids, sizes[s]);
+        g_free(ids);
+    }
+    return 0;
+}
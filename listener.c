@@ -0,0 +1,230 @@
+#include <math.h>
+#include <string.h>
+#include "listener.h"
+
+#define DEG_TO_RAD ((float)M_PI / 180.0f)
+#define RAD_TO_DEG (180.0f / (float)M_PI)
+
+void listener_rotation_init(ListenerRotation *rot)
+{
+    memset(rot, 0, sizeof(*rot));
+    rot->m[0] = rot->m[4] = rot->m[8] = 1.0f;
+    rot->identity = true;
+}
+
+/* m = (Rz(yaw) * Ry(-pitch) * Rx(roll))^T, the inverse of the head pose */
+void listener_rotation_set(ListenerRotation *rot, float yaw, float pitch, float roll)
+{
+    if (yaw == 0.0f && pitch == 0.0f && roll == 0.0f) {
+        listener_rotation_init(rot);
+        return;
+    }
+
+    float cy = cosf(yaw * DEG_TO_RAD), sy = sinf(yaw * DEG_TO_RAD);
+    float cp = cosf(pitch * DEG_TO_RAD), sp = sinf(pitch * DEG_TO_RAD);
+    float cr = cosf(roll * DEG_TO_RAD), sr = sinf(roll * DEG_TO_RAD);
+
+    /* Head pose R, row-major; its columns are the head axes in world coordinates */
+    float r[9] = {
+        cy * cp, -sy * cr - cy * sp * sr,  sy * sr - cy * sp * cr,
+        sy * cp,  cy * cr - sy * sp * sr, -cy * sr - sy * sp * cr,
+        sp,       cp * sr,                 cp * cr,
+    };
+
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++)
+            rot->m[row * 3 + col] = r[col * 3 + row];
+    }
+    rot->identity = false;
+}
+
+void listener_rotation_apply(const ListenerRotation *rot, float azimuth, float elevation,
+                             float *head_azimuth, float *head_elevation)
+{
+    if (rot->identity) {
+        *head_azimuth = azimuth;
+        *head_elevation = elevation;
+        return;
+    }
+
+    float ca = cosf(azimuth * DEG_TO_RAD), sa = sinf(azimuth * DEG_TO_RAD);
+    float ce = cosf(elevation * DEG_TO_RAD), se = sinf(elevation * DEG_TO_RAD);
+    float w[3] = {ce * ca, ce * sa, se};
+    const float *m = rot->m;
+
+    float x = m[0] * w[0] + m[1] * w[1] + m[2] * w[2];
+    float y = m[3] * w[0] + m[4] * w[1] + m[5] * w[2];
+    float z = m[6] * w[0] + m[7] * w[1] + m[8] * w[2];
+
+    float az = atan2f(y, x) * RAD_TO_DEG;
+    *head_azimuth = az < 0.0f ? az + 360.0f : az;
+    *head_elevation = asinf(fmaxf(-1.0f, fminf(1.0f, z))) * RAD_TO_DEG;
+}
+
+/* Gains of the alpha-beta tracker, critically damped: beta = alpha^2 / (2 - alpha) */
+#define PREDICT_ALPHA 0.6f
+#define PREDICT_BETA 0.257f
+#define PREDICT_GAP_USEC 250000     /* a longer gap restarts the tracker at rest */
+#define PREDICT_MAX_SPAN_USEC 200000 /* no extrapolation past this; the pose is held */
+#define PREDICT_MAX_RATE 1000.0f    /* degrees per second */
+#define PREDICT_SETTLED_DEG 0.05f   /* closer than this to the newest sample counts as held */
+#define PREDICT_HOLD_INTERVALS 3    /* silence, in mean sample intervals, before a hold is assumed */
+#define PREDICT_INTERVAL_WEIGHT 0.1f
+
+static float wrap_degrees(float a)
+{
+    a = fmodf(a + 180.0f, 360.0f);
+    return (a < 0.0f ? a + 360.0f : a) - 180.0f;
+}
+
+void listener_predictor_init(ListenerPredictor *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+/* Euclidean norm of the per-axis angle differences */
+static float pose_error(const float a[3], const float b[3])
+{
+    float sq = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float d = wrap_degrees(a[i] - b[i]);
+        sq += d * d;
+    }
+    return sqrtf(sq);
+}
+
+/*
+ * Scores the predictions whose target time the sample pair [last, now]
+ * covers. With score false, or when either end is a synthesized hold,
+ * they are only retired: there is no measured pose to compare against.
+ */
+static void score_checks(ListenerPredictor *p, const float ypr[3], uint64_t sample_usec, bool score)
+{
+    score = score && !p->last_synthetic;
+
+    while (p->n_checks > 0) {
+        ListenerCheck *c = &p->checks[p->check_head];
+        if (c->target_usec > sample_usec)
+            break;
+
+        if (score && c->target_usec >= p->last_usec) {
+            float t = sample_usec > p->last_usec
+                ? (float)(c->target_usec - p->last_usec) / (float)(sample_usec - p->last_usec) : 1.0f;
+            float actual[3];
+            for (int i = 0; i < 3; i++)
+                actual[i] = p->last_sample[i] + t * wrap_degrees(ypr[i] - p->last_sample[i]);
+
+            ListenerErrors *e = &p->errors;
+            float err = pose_error(c->predicted, actual);
+            float held = pose_error(c->held, actual);
+            e->n++;
+            e->sq_predicted += (double)err * err;
+            e->sq_held += (double)held * held;
+            e->max_predicted = fmaxf(e->max_predicted, err);
+            e->max_held = fmaxf(e->max_held, held);
+            e->span_usec += c->span_usec;
+        }
+        p->check_head = (p->check_head + 1) % LISTENER_CHECKS;
+        p->n_checks--;
+    }
+}
+
+static void predictor_update(ListenerPredictor *p, const float ypr[3], uint64_t sample_usec,
+                             bool synthetic)
+{
+    if (p->last_usec && sample_usec < p->last_usec)
+        return;
+    if (p->last_usec)
+        score_checks(p, ypr, sample_usec, !synthetic);
+
+    uint64_t dt_usec = p->last_usec ? sample_usec - p->last_usec : 0;
+    if (!synthetic && !p->last_synthetic && dt_usec > 0 && dt_usec <= PREDICT_GAP_USEC) {
+        p->interval_usec = p->interval_usec
+            ? p->interval_usec + PREDICT_INTERVAL_WEIGHT * ((float)dt_usec - p->interval_usec)
+            : (float)dt_usec;
+    }
+
+    if (!p->last_usec || dt_usec > PREDICT_GAP_USEC) {
+        for (int i = 0; i < 3; i++)
+            p->axes[i] = (ListenerAxis){ypr[i], 0.0f};
+    } else if (dt_usec > 0) {
+        float dt = (float)dt_usec / 1e6f;
+        for (int i = 0; i < 3; i++) {
+            ListenerAxis *a = &p->axes[i];
+            float predicted = a->angle + a->rate * dt;
+            float residual = wrap_degrees(ypr[i] - predicted);
+            a->angle = wrap_degrees(predicted + PREDICT_ALPHA * residual);
+            a->rate = fmaxf(-PREDICT_MAX_RATE,
+                            fminf(PREDICT_MAX_RATE, a->rate + PREDICT_BETA * residual / dt));
+        }
+    }
+
+    memcpy(p->last_sample, ypr, sizeof(p->last_sample));
+    p->last_usec = sample_usec;
+    p->last_synthetic = synthetic;
+}
+
+void listener_predictor_sample(ListenerPredictor *p, const float ypr[3], uint64_t sample_usec)
+{
+    predictor_update(p, ypr, sample_usec, false);
+}
+
+/*
+ * Once the tracker has been silent for a few of its own sample intervals,
+ * takes the head to be holding the newest pose and feeds that in, stamped
+ * now_usec, so the velocity decays. Returns true if a hold was fed.
+ * Slower or jittery trackers are left alone between real samples.
+ */
+bool listener_predictor_hold(ListenerPredictor *p, uint64_t now_usec)
+{
+    if (!p->last_usec || now_usec <= p->last_usec)
+        return false;
+
+    float timeout = p->interval_usec > 0.0f ? PREDICT_HOLD_INTERVALS * p->interval_usec
+                                            : (float)PREDICT_GAP_USEC;
+    if ((float)(now_usec - p->last_usec) < timeout)
+        return false;
+
+    float held[3];
+    memcpy(held, p->last_sample, sizeof(held));
+    predictor_update(p, held, now_usec, true);
+    return true;
+}
+
+/*
+ * Pose expected at target_usec; the prediction is queued for scoring.
+ * Returns true while it departs from the newest sample, i.e. while more
+ * samples are needed for it to settle.
+ */
+bool listener_predictor_predict(ListenerPredictor *p, uint64_t target_usec, float ypr[3])
+{
+    if (!p->last_usec) {
+        ypr[0] = ypr[1] = ypr[2] = 0.0f;
+        return false;
+    }
+
+    bool moving = false;
+    uint64_t span = target_usec > p->last_usec ? target_usec - p->last_usec : 0;
+    if (span <= PREDICT_MAX_SPAN_USEC) {
+        float t = (float)span / 1e6f;
+        for (int i = 0; i < 3; i++)
+            ypr[i] = wrap_degrees(p->axes[i].angle + p->axes[i].rate * t);
+        ypr[1] = fmaxf(-90.0f, fminf(90.0f, ypr[1]));
+        for (int i = 0; i < 3; i++)
+            moving |= fabsf(wrap_degrees(ypr[i] - p->last_sample[i])) > PREDICT_SETTLED_DEG;
+    } else {
+        memcpy(ypr, p->last_sample, sizeof(p->last_sample));
+    }
+
+    if (p->n_checks == LISTENER_CHECKS) {
+        p->check_head = (p->check_head + 1) % LISTENER_CHECKS;
+        p->n_checks--;
+    }
+    ListenerCheck *c = &p->checks[(p->check_head + p->n_checks) % LISTENER_CHECKS];
+    c->target_usec = target_usec;
+    c->span_usec = span;
+    memcpy(c->predicted, ypr, sizeof(c->predicted));
+    memcpy(c->held, p->last_sample, sizeof(c->held));
+    p->n_checks++;
+    return moving;
+}
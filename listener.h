@@ -0,0 +1,70 @@
+#ifndef PW_MIXER_LISTENER_H
+#define PW_MIXER_LISTENER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * World -> head rotation for the listener orientation. Frame: x ahead,
+ * y towards azimuth 90, z up; yaw turns the head towards increasing
+ * azimuth, positive pitch looks up, positive roll lowers the azimuth-90
+ * side. Built once per orientation change, applied per speaker.
+ */
+typedef struct {
+    float m[9];          /* row-major, head = m * world */
+    bool identity;
+} ListenerRotation;
+
+void listener_rotation_init(ListenerRotation *rot);
+void listener_rotation_set(ListenerRotation *rot, float yaw, float pitch, float roll);
+void listener_rotation_apply(const ListenerRotation *rot, float azimuth, float elevation,
+                             float *head_azimuth, float *head_elevation);
+
+/*
+ * Constant-velocity (alpha-beta) tracker for the head pose, so a control
+ * send can carry the pose for the moment it will be heard instead of the
+ * last one reported. Angles in degrees, times in microseconds on the
+ * monotonic clock. Every prediction is kept until samples covering its
+ * target time arrive and is then scored against them.
+ */
+#define LISTENER_CHECKS 16
+
+typedef struct {
+    float angle;
+    float rate;              /* degrees per second */
+} ListenerAxis;
+
+typedef struct {
+    uint64_t target_usec;
+    uint64_t span_usec;      /* target minus the newest sample's time */
+    float predicted[3];
+    float held[3];           /* newest sample: what an unpredicted send carries */
+} ListenerCheck;
+
+/* Predicted-versus-actual pose error, in degrees, since the last report */
+typedef struct {
+    uint32_t n;
+    double sq_predicted;
+    double sq_held;
+    float max_predicted;
+    float max_held;
+    uint64_t span_usec;      /* sum over the n checks */
+} ListenerErrors;
+
+typedef struct {
+    ListenerAxis axes[3];    /* yaw, pitch, roll */
+    float last_sample[3];
+    uint64_t last_usec;      /* 0 until the first sample */
+    bool last_synthetic;     /* newest sample is a hold fed by listener_predictor_hold() */
+    float interval_usec;     /* running mean of the tracker's own sample interval */
+    ListenerCheck checks[LISTENER_CHECKS];
+    uint32_t check_head, n_checks;
+    ListenerErrors errors;
+} ListenerPredictor;
+
+void listener_predictor_init(ListenerPredictor *p);
+void listener_predictor_sample(ListenerPredictor *p, const float ypr[3], uint64_t sample_usec);
+bool listener_predictor_hold(ListenerPredictor *p, uint64_t now_usec);
+bool listener_predictor_predict(ListenerPredictor *p, uint64_t target_usec, float ypr[3]);
+
+#endif /* PW_MIXER_LISTENER_H */
@@ -9,7 +9,7 @@ static void activate(GtkApplication *app, gpointer user_data)
 {
     AppData *data = user_data;
     build_gui(data);
-    gtk_window_present(GTK_WINDOW(data->window));
+    gtk_window_present(GTK_WINDOW(data->ui->window));
 }
 
 int main(int argc, char *argv[])
@@ -34,9 +34,9 @@ int main(int argc, char *argv[])
     shutdown_pipewire(&data);
 
     g_object_unref(app);
+    g_free(data.ui);
 
-    if (data.links) g_hash_table_destroy(data.links);
-    if (data.ports) g_hash_table_destroy(data.ports);
+    clear_app_data(&data);
 
     return status;
 }
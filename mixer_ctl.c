@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "mixer_protocol.h"
+
+/*
+ * pw-3d-mixer-ctl: sends source updates to the control socket.
+ *
+ *   pw-3d-mixer-ctl 0:az=90,el=10 1:r=40,w=30 2:bypass=1 3:node=57
+ *   some-generator | pw-3d-mixer-ctl -     (one message per input line)
+ *
+ * All updates given together travel as one message and are applied as
+ * one batch. Keys: az, el, r, w, bypass, node (0 empties the slot).
+ */
+
+static uint32_t next_seq = 1;
+static bool connection_broken;   /* lost or out of step with the server; stop sending */
+
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static int connect_socket(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    char buf[sizeof(addr.sun_path)];
+
+    if (!path) {
+        const char *env = getenv("PW_MIXER_CONTROL_SOCKET");
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        if (env && env[0]) {
+            path = env;
+        } else if (dir) {
+            snprintf(buf, sizeof(buf), "%s/%s", dir, MIXER_SOCKET_NAME);
+            path = buf;
+        } else {
+            fprintf(stderr, "XDG_RUNTIME_DIR is not set; pass -s <socket>\n");
+            return -1;
+        }
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "cannot connect to %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Parses "slot:key=value,key=value" */
+static int parse_update(const char *arg, MixerSourceUpdate *u)
+{
+    char *end;
+    memset(u, 0, sizeof(*u));
+
+    long slot = strtol(arg, &end, 10);
+    if (end == arg || *end != ':' || slot < 0 || slot > 255)
+        return -1;
+    u->slot = (uint8_t)slot;
+
+    const char *p = end + 1;
+    while (*p) {
+        const char *eq = strchr(p, '=');
+        if (!eq)
+            return -1;
+        size_t klen = (size_t)(eq - p);
+        double v = strtod(eq + 1, &end);
+        if (end == eq + 1 || (*end && *end != ','))
+            return -1;
+
+        if (klen == 2 && strncmp(p, "az", 2) == 0) {
+            u->fields |= MIXER_SET_AZIMUTH;
+            u->azimuth = (float)v;
+        } else if (klen == 2 && strncmp(p, "el", 2) == 0) {
+            u->fields |= MIXER_SET_ELEVATION;
+            u->elevation = (float)v;
+        } else if (klen == 1 && *p == 'r') {
+            u->fields |= MIXER_SET_RADIUS;
+            u->radius = (float)v;
+        } else if (klen == 1 && *p == 'w') {
+            u->fields |= MIXER_SET_WIDTH;
+            u->width = (float)v;
+        } else if (klen == 6 && strncmp(p, "bypass", 6) == 0) {
+            u->fields |= MIXER_SET_BYPASS;
+            u->bypass = v != 0.0;
+        } else if (klen == 4 && strncmp(p, "node", 4) == 0) {
+            u->fields |= MIXER_SET_NODE;
+            u->node_id = (uint32_t)v;
+        } else {
+            return -1;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+/* Checks a reply header before its payload is read; a bad one ends the connection */
+static int check_reply_header(const MixerMsgHeader *header, uint32_t seq)
+{
+    if (header->version != MIXER_PROTOCOL_VERSION) {
+        fprintf(stderr, "server speaks protocol %u, this client %u\n",
+                header->version, MIXER_PROTOCOL_VERSION);
+        return -1;
+    }
+    if (header->type != MIXER_MSG_REPLY || header->length != sizeof(MixerReply)) {
+        fprintf(stderr, "unexpected message type %u length %u from server\n",
+                header->type, header->length);
+        return -1;
+    }
+    if (header->seq != seq) {
+        fprintf(stderr, "reply for seq %u while waiting for %u\n", header->seq, seq);
+        return -1;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+    for (size_t got = 0; got < len;) {
+        ssize_t n = read(fd, (char *)buf + got, len - got);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+/* Sends one message and prints the reply with server queue and apply time, filter round trip and client round trip */
+static int send_updates(int fd, const MixerSourceUpdate *updates, uint16_t count)
+{
+    struct {
+        MixerMsgHeader header;
+        MixerSourceUpdate updates[MIXER_MAX_UPDATES];
+    } msg;
+    MixerMsgHeader header;
+    MixerReply reply;
+
+    memset(&msg.header, 0, sizeof(msg.header));
+    msg.header.length = count * sizeof(MixerSourceUpdate);
+    msg.header.type = MIXER_MSG_UPDATE;
+    msg.header.count = count;
+    msg.header.seq = next_seq++;
+    msg.header.version = MIXER_PROTOCOL_VERSION;
+    memcpy(msg.updates, updates, count * sizeof(MixerSourceUpdate));
+
+    size_t len = sizeof(msg.header) + msg.header.length;
+    uint64_t start = now_usec();
+    if (send(fd, &msg, len, MSG_NOSIGNAL) != (ssize_t)len || read_full(fd, &header, sizeof(header)) < 0) {
+        fprintf(stderr, "connection lost: %s\n", strerror(errno));
+        connection_broken = true;
+        return -1;
+    }
+    if (check_reply_header(&header, msg.header.seq) < 0) {
+        connection_broken = true;
+        return -1;
+    }
+    if (read_full(fd, &reply, sizeof(reply)) < 0) {
+        fprintf(stderr, "connection lost: %s\n", strerror(errno));
+        connection_broken = true;
+        return -1;
+    }
+    uint64_t rtt = now_usec() - start;
+
+    printf("seq %u: applied %u/%u status %d queue %u us apply %u us filter %u us round trip %llu us\n",
+           reply.seq, reply.applied, count, reply.status,
+           reply.queue_usec, reply.apply_usec, reply.filter_usec, (unsigned long long)rtt);
+    return reply.status == 0 ? 0 : -1;
+}
+
+/* Whitespace-separated updates, up to MIXER_MAX_UPDATES per message */
+static int send_words(int fd, char **words, int n_words)
+{
+    MixerSourceUpdate updates[MIXER_MAX_UPDATES];
+    uint16_t count = 0;
+    int rc = 0;
+
+    for (int i = 0; i < n_words; i++) {
+        if (parse_update(words[i], &updates[count]) < 0) {
+            fprintf(stderr, "bad update '%s' (expected slot:key=value,...)\n", words[i]);
+            return -1;
+        }
+        if (++count == MIXER_MAX_UPDATES) {
+            rc |= send_updates(fd, updates, count);
+            count = 0;
+            if (connection_broken)
+                return -1;
+        }
+    }
+    if (count > 0)
+        rc |= send_updates(fd, updates, count);
+    return rc;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s socket] slot:key=value[,key=value...] ...\n"
+            "       %s [-s socket] -      read one batch per line from stdin\n"
+            "keys: az el r w bypass node\n",
+            prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+        path = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = connect_socket(path);
+    if (fd < 0)
+        return 1;
+
+    int rc = 0;
+    if (strcmp(argv[first], "-") == 0) {
+        char line[4096];
+        while (!connection_broken && fgets(line, sizeof(line), stdin)) {
+            char *words[256];
+            int n = 0;
+            for (char *tok = strtok(line, " \t\r\n"); tok && n < 256; tok = strtok(NULL, " \t\r\n"))
+                words[n++] = tok;
+            if (n > 0 && send_words(fd, words, n) < 0)
+                rc = 1;
+        }
+    } else {
+        rc = send_words(fd, argv + first, argc - first) < 0;
+    }
+
+    close(fd);
+    return rc;
+}
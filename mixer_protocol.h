@@ -0,0 +1,64 @@
+#ifndef PW_MIXER_PROTOCOL_H
+#define PW_MIXER_PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * Control socket wire format, shared by the server (control_socket.c) and
+ * pw-3d-mixer-ctl. Every message is a MixerMsgHeader followed by `length`
+ * payload bytes. The socket is local, so fields use host byte order.
+ * Both sides put MIXER_PROTOCOL_VERSION in every header; the server answers
+ * a message of another version with -EPROTONOSUPPORT and hangs up.
+ */
+
+#define MIXER_PROTOCOL_VERSION 4
+#define MIXER_SOCKET_NAME "pw-3d-mixer.sock"   /* in $XDG_RUNTIME_DIR */
+#define MIXER_MAX_UPDATES 64                   /* source updates per message */
+
+typedef enum {
+    MIXER_MSG_UPDATE = 1,    /* client -> server: count MixerSourceUpdate */
+    MIXER_MSG_REPLY = 2,     /* server -> client: one MixerReply */
+} MixerMsgType;
+
+typedef struct {
+    uint32_t length;         /* payload bytes after the header */
+    uint16_t type;           /* MixerMsgType */
+    uint16_t count;          /* entries in the payload */
+    uint32_t seq;            /* chosen by the client, echoed in the reply */
+    uint16_t version;        /* MIXER_PROTOCOL_VERSION of the sender */
+    uint16_t reserved;
+} MixerMsgHeader;
+
+enum {
+    MIXER_SET_AZIMUTH   = 1 << 0,
+    MIXER_SET_ELEVATION = 1 << 1,
+    MIXER_SET_RADIUS    = 1 << 2,
+    MIXER_SET_WIDTH     = 1 << 3,
+    MIXER_SET_BYPASS    = 1 << 4,
+    MIXER_SET_NODE      = 1 << 5,
+};
+
+/* Fields not flagged in `fields` are left as they are */
+typedef struct {
+    uint8_t slot;            /* 0..MAX_SOURCES-1 */
+    uint8_t fields;          /* MIXER_SET_* */
+    uint8_t bypass;
+    uint8_t reserved;
+    uint32_t node_id;        /* stream node for the slot, 0 empties it */
+    float azimuth;           /* degrees, 0-360 */
+    float elevation;         /* degrees, -90..90 */
+    float radius;            /* percent, MIN_RADIUS_PCT..100 */
+    float width;             /* stereo width in degrees, 0..90 */
+} MixerSourceUpdate;
+
+typedef struct {
+    uint32_t seq;
+    int32_t status;          /* 0 or a negative errno */
+    uint16_t applied;        /* updates that were valid and applied */
+    uint16_t reserved;
+    uint32_t queue_usec;     /* message received -> handed to the control and link paths */
+    uint32_t filter_usec;    /* running mean of filter Props send -> read-back, 0 until measured */
+    uint32_t apply_usec;     /* message received -> filter answered the Props update carrying it, 0 if not */
+} MixerReply;
+
+#endif /* PW_MIXER_PROTOCOL_H */
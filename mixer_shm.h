@@ -0,0 +1,109 @@
+#ifndef PW_MIXER_SHM_H
+#define PW_MIXER_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "mixer_protocol.h"
+
+/*
+ * Shared-memory state block (shm_open(PW_MIXER_SHM_NAME)). The controller
+ * publishes live source state; one external process at a time writes
+ * targets and the listener orientation, which the controller picks up on
+ * its control tick. Each half is guarded by its own seqlock, so neither
+ * side makes a syscall to read or write. Include this header as-is in
+ * trackers and visualizers.
+ */
+
+#define MIXER_SHM_MAGIC   0x3358494du   /* "MIX3" */
+#define MIXER_SHM_VERSION 2
+#define MIXER_SHM_SOURCES 4
+#define MIXER_SHM_LABEL   64
+
+typedef struct {
+    float yaw;               /* degrees, head rotation about the vertical axis */
+    float pitch;
+    float roll;
+} MixerShmOrientation;
+
+/* Controller -> readers */
+typedef struct {
+    float azimuth;           /* degrees, 0-360 */
+    float elevation;         /* degrees, -90..90 */
+    float radius;            /* percent */
+    float width;             /* stereo width in degrees */
+    uint8_t bypass;
+    uint8_t is_playing;
+    uint8_t reserved[2];
+    char app_label[MIXER_SHM_LABEL];
+} MixerShmSource;
+
+typedef struct {
+    MixerShmSource sources[MIXER_SHM_SOURCES];
+    MixerShmOrientation listener;  /* as applied: predicted and clamped, not the written target */
+} MixerShmState;
+
+/* Writer -> controller; a field is applied when it is flagged and differs from the last read */
+typedef struct {
+    uint32_t fields;         /* MIXER_SET_* */
+    uint32_t node_id;
+    float azimuth;
+    float elevation;
+    float radius;
+    float width;
+    uint8_t bypass;
+    uint8_t reserved[3];
+} MixerShmTarget;
+
+typedef struct {
+    MixerShmTarget sources[MIXER_SHM_SOURCES];
+    MixerShmOrientation listener;
+} MixerShmTargets;
+
+typedef struct {
+    uint32_t magic;          /* stored last, once the block is initialised */
+    uint32_t version;
+    uint32_t size;           /* sizeof(MixerShmBlock) */
+    uint32_t n_sources;
+    uint32_t owner_pid;      /* controller that created the block */
+
+    _Alignas(64) uint32_t state_seq;     /* odd while the controller writes */
+    MixerShmState state;
+
+    _Alignas(64) uint32_t target_seq;    /* odd while the external writer writes */
+    MixerShmTargets targets;
+} MixerShmBlock;
+
+/* Seqlock write: callers on one side must not write concurrently */
+static inline void mixer_shm_write(uint32_t *seq, void *dst, const void *src, size_t len)
+{
+    uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(dst, src, len);
+    __atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
+
+/* Seqlock read into dst; false if every attempt overlapped a write */
+static inline bool mixer_shm_read(const uint32_t *seq, void *dst, const void *src, size_t len,
+                                  uint32_t *seq_out)
+{
+    for (int attempt = 0; attempt < 64; attempt++) {
+        uint32_t s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (s & 1)
+            continue;
+
+        memcpy(dst, src, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, __ATOMIC_RELAXED) == s) {
+            if (seq_out)
+                *seq_out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif /* PW_MIXER_SHM_H */
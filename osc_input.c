@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+#include <pipewire/pipewire.h>
+#include "control_socket.h"
+#include "osc_input.h"
+#include "pipewire.h"
+
+#define OSC_MAX_AGE_MS_DEFAULT 50
+#define OSC_MAX_ARGS 4
+#define OSC_MAX_BUNDLE_DEPTH 4
+#define OSC_TIMETAG_NOW 1ull              /* "immediately": no age check */
+#define OSC_NTP_UNIX_OFFSET 2208988800ull /* seconds from 1900 to 1970 */
+
+typedef struct {
+    uint64_t datagrams;
+    uint64_t messages;
+    uint64_t stale;          /* bundle older than the maximum age */
+    uint64_t reordered;      /* older than a value already taken for the same target */
+    uint64_t coalesced;      /* replaced before a tick applied it */
+    uint64_t malformed;
+    uint64_t unknown;        /* well-formed, but no such address */
+    uint64_t ticks;
+} OscStats;
+
+/* Newest values per slot since the last tick */
+typedef struct {
+    uint32_t fields;         /* MIXER_SET_* */
+    float azimuth;
+    float elevation;
+    float radius;
+    float width;
+    uint8_t bypass;
+} OscPending;
+
+/* Newest timetag taken per address of a slot; each address is its own target */
+typedef struct {
+    uint64_t aed;
+    uint64_t width;
+    uint64_t bypass;
+} OscSlotTimetags;
+
+struct OscInput {
+    AppData *app;
+    struct pw_loop *loop;
+    struct spa_source *io;
+    struct spa_source *timer;
+    bool timer_armed;
+    gint64 period_usec;
+    uint64_t max_age_usec;
+
+    OscPending sources[MAX_SOURCES];
+    OscSlotTimetags source_timetags[MAX_SOURCES];
+    bool listener_pending;
+    bool listener_moving;    /* last pose sent was extrapolated; keep ticking until it settles */
+    uint64_t listener_timetag;
+
+    OscStats stats;
+};
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} OscReader;
+
+static bool osc_read_u32(OscReader *r, uint32_t *v)
+{
+    if (r->end - r->p < 4)
+        return false;
+    memcpy(v, r->p, 4);
+    *v = ntohl(*v);
+    r->p += 4;
+    return true;
+}
+
+static bool osc_read_u64(OscReader *r, uint64_t *v)
+{
+    uint32_t hi, lo;
+    if (!osc_read_u32(r, &hi) || !osc_read_u32(r, &lo))
+        return false;
+    *v = (uint64_t)hi << 32 | lo;
+    return true;
+}
+
+/* OSC strings are NUL terminated and padded to a multiple of four bytes */
+static bool osc_read_string(OscReader *r, const char **s)
+{
+    const uint8_t *nul = memchr(r->p, '\0', (size_t)(r->end - r->p));
+    if (!nul)
+        return false;
+    size_t padded = ((size_t)(nul - r->p) + 4) & ~(size_t)3;
+    if ((size_t)(r->end - r->p) < padded)
+        return false;
+    *s = (const char *)r->p;
+    r->p += padded;
+    return true;
+}
+
+/* Numeric arguments, whatever their OSC type, as floats */
+static int osc_read_args(OscReader *r, const char *tags, float *args)
+{
+    int n = 0;
+
+    for (const char *t = tags + 1; *t; t++) {
+        uint32_t u32;
+        uint64_t u64;
+        float f;
+        double d;
+
+        if (n == OSC_MAX_ARGS)
+            return -1;
+        switch (*t) {
+        case 'f':
+            if (!osc_read_u32(r, &u32))
+                return -1;
+            memcpy(&f, &u32, 4);
+            args[n++] = f;
+            break;
+        case 'i':
+            if (!osc_read_u32(r, &u32))
+                return -1;
+            args[n++] = (float)(int32_t)u32;
+            break;
+        case 'd':
+            if (!osc_read_u64(r, &u64))
+                return -1;
+            memcpy(&d, &u64, 8);
+            args[n++] = (float)d;
+            break;
+        case 'h':
+            if (!osc_read_u64(r, &u64))
+                return -1;
+            args[n++] = (float)(int64_t)u64;
+            break;
+        case 'T':
+            args[n++] = 1.0f;
+            break;
+        case 'F':
+            args[n++] = 0.0f;
+            break;
+        default:
+            return -1;
+        }
+    }
+    return n;
+}
+
+static uint64_t timetag_to_usec(uint64_t timetag)
+{
+    uint64_t sec = timetag >> 32;
+    uint64_t frac = timetag & 0xffffffffu;
+    if (sec < OSC_NTP_UNIX_OFFSET)
+        return 0;
+    return (sec - OSC_NTP_UNIX_OFFSET) * G_USEC_PER_SEC + ((frac * G_USEC_PER_SEC) >> 32);
+}
+
+/* Takes a value for a target unless a newer one already arrived for it */
+static bool take_timetag(OscInput *osc, uint64_t *last, uint64_t timetag)
+{
+    if (timetag != OSC_TIMETAG_NOW) {
+        if (timetag < *last) {
+            osc->stats.reordered++;
+            return false;
+        }
+        *last = timetag;
+    }
+    return true;
+}
+
+static void osc_timer_arm(OscInput *osc)
+{
+    if (osc->timer_armed || !osc->timer)
+        return;
+    struct timespec value = {osc->period_usec / G_USEC_PER_SEC,
+                             (long)(osc->period_usec % G_USEC_PER_SEC) * 1000};
+    pw_loop_update_timer(osc->loop, osc->timer, &value, &value, false);
+    osc->timer_armed = true;
+}
+
+static void osc_timer_disarm(OscInput *osc)
+{
+    if (!osc->timer_armed)
+        return;
+    struct timespec zero = {0, 0};
+    pw_loop_update_timer(osc->loop, osc->timer, &zero, &zero, false);
+    osc->timer_armed = false;
+}
+
+static void pend_source(OscInput *osc, int slot, uint32_t fields, const float *args,
+                        uint64_t *last_timetag, uint64_t timetag)
+{
+    OscPending *p = &osc->sources[slot];
+
+    if (!take_timetag(osc, last_timetag, timetag))
+        return;
+    if (p->fields & fields)
+        osc->stats.coalesced++;
+
+    if (fields & MIXER_SET_AZIMUTH)
+        p->azimuth = args[0];
+    if (fields & MIXER_SET_ELEVATION)
+        p->elevation = args[1];
+    if (fields & MIXER_SET_RADIUS)
+        p->radius = args[2];
+    if (fields & MIXER_SET_WIDTH)
+        p->width = args[0];
+    if (fields & MIXER_SET_BYPASS)
+        p->bypass = args[0] != 0.0f;
+    p->fields |= fields;
+    osc_timer_arm(osc);
+}
+
+static void handle_message(OscInput *osc, OscReader *r, uint64_t timetag)
+{
+    const char *address, *tags;
+    float args[OSC_MAX_ARGS];
+
+    osc->stats.messages++;
+    int n = -1;
+    if (osc_read_string(r, &address) && osc_read_string(r, &tags) && tags[0] == ',')
+        n = osc_read_args(r, tags, args);
+    if (n < 0) {
+        osc->stats.malformed++;
+        return;
+    }
+
+    if (strcmp(address, "/listener/ypr") == 0 && n == 3) {
+        if (!take_timetag(osc, &osc->listener_timetag, timetag))
+            return;
+        if (osc->listener_pending)
+            osc->stats.coalesced++;
+        /*
+         * Every pose feeds the predictor, stamped with when the tracker sent it.
+         * The age comes from the realtime clock, the stamp is monotonic: the two
+         * are assumed to advance together over the few milliseconds of the age
+         * window. Clamping to [0, max age] keeps a future timetag or a clock
+         * step from moving the stamp further than a valid bundle could.
+         */
+        gint64 sample_usec = g_get_monotonic_time();
+        if (timetag != OSC_TIMETAG_NOW) {
+            gint64 age = g_get_real_time() - (gint64)timetag_to_usec(timetag);
+            sample_usec -= CLAMP(age, 0, (gint64)osc->max_age_usec);
+        }
+        track_listener_orientation(osc->app, args[0], args[1], args[2], sample_usec);
+        osc->listener_pending = true;
+        osc_timer_arm(osc);
+        return;
+    }
+
+    int slot, end = 0;
+    char what[16];
+    if (sscanf(address, "/source/%d/%15[a-z]%n", &slot, what, &end) == 2 && address[end] == '\0' &&
+        slot >= 1 && slot <= MAX_SOURCES) {
+        OscSlotTimetags *tt = &osc->source_timetags[slot - 1];
+        if (strcmp(what, "aed") == 0 && n == 3) {
+            pend_source(osc, slot - 1, MIXER_SET_AZIMUTH | MIXER_SET_ELEVATION | MIXER_SET_RADIUS,
+                        args, &tt->aed, timetag);
+            return;
+        }
+        if (strcmp(what, "width") == 0 && n == 1) {
+            pend_source(osc, slot - 1, MIXER_SET_WIDTH, args, &tt->width, timetag);
+            return;
+        }
+        if (strcmp(what, "bypass") == 0 && n == 1) {
+            pend_source(osc, slot - 1, MIXER_SET_BYPASS, args, &tt->bypass, timetag);
+            return;
+        }
+    }
+    osc->stats.unknown++;
+}
+
+static void handle_packet(OscInput *osc, OscReader *r, uint64_t timetag, int depth)
+{
+    if (r->end - r->p >= 8 && memcmp(r->p, "#bundle", 8) == 0) {
+        uint64_t bundle_tt;
+        r->p += 8;
+        if (depth >= OSC_MAX_BUNDLE_DEPTH || !osc_read_u64(r, &bundle_tt)) {
+            osc->stats.malformed++;
+            return;
+        }
+
+        if (bundle_tt != OSC_TIMETAG_NOW) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t now = (uint64_t)ts.tv_sec * G_USEC_PER_SEC + (uint64_t)ts.tv_nsec / 1000;
+            uint64_t sent = timetag_to_usec(bundle_tt);
+            if (sent + osc->max_age_usec < now) {
+                osc->stats.stale++;
+                return;
+            }
+            timetag = bundle_tt;
+        }
+
+        while (r->p < r->end) {
+            uint32_t size;
+            if (!osc_read_u32(r, &size) || size > (uint32_t)(r->end - r->p) || (size & 3)) {
+                osc->stats.malformed++;
+                return;
+            }
+            OscReader element = {r->p, r->p + size};
+            handle_packet(osc, &element, timetag, depth + 1);
+            r->p += size;
+        }
+        return;
+    }
+
+    handle_message(osc, r, timetag);
+}
+
+static void on_osc_io(void *data, int fd, uint32_t mask)
+{
+    (void)mask;
+    OscInput *osc = data;
+    uint8_t buf[2048];
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_TRUNC);
+        if (n < 0)
+            return;
+
+        osc->stats.datagrams++;
+        if ((size_t)n > sizeof(buf) || (n & 3)) {
+            osc->stats.malformed++;
+            continue;
+        }
+        OscReader r = {buf, buf + n};
+        handle_packet(osc, &r, OSC_TIMETAG_NOW, 0);
+    }
+}
+
+/* Control tick: the newest value of every target goes out as one batch */
+static void on_osc_tick(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    OscInput *osc = data;
+    MixerSourceUpdate updates[MAX_SOURCES];
+    uint16_t count = 0;
+
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        OscPending *p = &osc->sources[i];
+        if (!p->fields)
+            continue;
+        updates[count] = (MixerSourceUpdate){
+            .slot = (uint8_t)i,
+            .fields = (uint8_t)p->fields,
+            .bypass = p->bypass,
+            .azimuth = p->azimuth,
+            .elevation = p->elevation,
+            .radius = p->radius,
+            .width = p->width,
+        };
+        count++;
+        p->fields = 0;
+    }
+
+    if (osc->listener_pending || osc->listener_moving) {
+        osc->listener_moving = apply_tracked_orientation(osc->app, osc->listener_pending);
+        osc->listener_pending = false;
+    }
+
+    if (count == 0) {
+        /* Idle: sleep until the next datagram re-arms the tick, once the pose has settled */
+        if (!osc->listener_moving)
+            osc_timer_disarm(osc);
+        return;
+    }
+    osc->stats.ticks++;
+    control_apply_updates(osc->app, updates, count);
+}
+
+OscInput *osc_input_start(AppData *app)
+{
+    const char *port_s = g_getenv("PW_MIXER_OSC_PORT");
+    int port = port_s ? atoi(port_s) : 0;
+    if (port <= 0 || port > 65535)
+        return NULL;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "[osc] cannot listen on 127.0.0.1:%d: %s\n", port, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    OscInput *osc = g_new0(OscInput, 1);
+    osc->app = app;
+    osc->loop = pw_main_loop_get_loop(app->loop);
+    osc->period_usec = control_period_from_env();
+
+    const char *age_s = g_getenv("PW_MIXER_OSC_MAX_AGE_MS");
+    int age_ms = age_s ? atoi(age_s) : OSC_MAX_AGE_MS_DEFAULT;
+    osc->max_age_usec = (uint64_t)(age_ms > 0 ? age_ms : OSC_MAX_AGE_MS_DEFAULT) * 1000;
+
+    osc->timer = pw_loop_add_timer(osc->loop, on_osc_tick, osc);
+    osc->io = pw_loop_add_io(osc->loop, fd, SPA_IO_IN, true, on_osc_io, osc);
+    if (!osc->io) {
+        close(fd);
+        osc_input_stop(osc);
+        return NULL;
+    }
+
+    printf("[osc] listening on 127.0.0.1:%d, control tick %lld us, max age %d ms\n",
+           port, (long long)osc->period_usec, age_ms > 0 ? age_ms : OSC_MAX_AGE_MS_DEFAULT);
+    return osc;
+}
+
+void osc_input_stop(OscInput *osc)
+{
+    if (!osc)
+        return;
+
+    if (osc->stats.datagrams > 0) {
+        const OscStats *st = &osc->stats;
+        printf("[osc] %llu datagrams, %llu messages in %llu ticks: %llu coalesced, %llu stale, "
+               "%llu reordered, %llu malformed, %llu unknown\n",
+               (unsigned long long)st->datagrams, (unsigned long long)st->messages,
+               (unsigned long long)st->ticks, (unsigned long long)st->coalesced,
+               (unsigned long long)st->stale, (unsigned long long)st->reordered,
+               (unsigned long long)st->malformed, (unsigned long long)st->unknown);
+    }
+
+    if (osc->io)
+        pw_loop_destroy_source(osc->loop, osc->io);
+    if (osc->timer)
+        pw_loop_destroy_source(osc->loop, osc->timer);
+    g_free(osc);
+}
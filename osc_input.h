@@ -0,0 +1,19 @@
+#ifndef PW_MIXER_OSC_INPUT_H
+#define PW_MIXER_OSC_INPUT_H
+
+#include "app.h"
+
+/*
+ * OSC over UDP on 127.0.0.1:PW_MIXER_OSC_PORT, served on the PipeWire
+ * loop. Values are coalesced per target and the newest ones are applied
+ * once per control tick.
+ *
+ *   /source/N/aed f f f    azimuth, elevation, radius (%) of slot N (1-based)
+ *   /source/N/width f
+ *   /source/N/bypass i
+ *   /listener/ypr f f f    listener yaw, pitch, roll in degrees
+ */
+OscInput *osc_input_start(AppData *app);
+void osc_input_stop(OscInput *osc);
+
+#endif /* PW_MIXER_OSC_INPUT_H */
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Local OSC test sender for the controller's OSC input: circles slot 1
+ * around the listener and turns the listener's head, each datagram a
+ * timestamped bundle. Every Nth bundle can be backdated to exercise the
+ * stale-datagram check.
+ *
+ *   meson compile -C build osc-send
+ *   PW_MIXER_OSC_PORT=9000 ./build/pw-3d-mixer &
+ *   ./build/osc-send -p 9000 -r 200 -n 2000 -s 10
+ */
+
+#define OSC_NTP_UNIX_OFFSET 2208988800ull
+
+typedef struct {
+    uint8_t data[256];
+    size_t len;
+} OscBuffer;
+
+static void put_u32(OscBuffer *b, uint32_t v)
+{
+    v = htonl(v);
+    memcpy(b->data + b->len, &v, 4);
+    b->len += 4;
+}
+
+static void put_string(OscBuffer *b, const char *s)
+{
+    size_t n = strlen(s) + 1;
+    size_t padded = (n + 3) & ~(size_t)3;
+    memset(b->data + b->len, 0, padded);
+    memcpy(b->data + b->len, s, n);
+    b->len += padded;
+}
+
+static void put_float(OscBuffer *b, float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    put_u32(b, u);
+}
+
+/* Appends one bundle element: size, address, ",fff..." and the floats */
+static void put_message(OscBuffer *b, const char *address, const float *args, int n)
+{
+    char tags[8] = ",";
+    size_t size_at = b->len;
+
+    put_u32(b, 0);
+    put_string(b, address);
+    for (int i = 0; i < n; i++)
+        tags[i + 1] = 'f';
+    put_string(b, tags);
+    for (int i = 0; i < n; i++)
+        put_float(b, args[i]);
+
+    uint32_t size = htonl((uint32_t)(b->len - size_at - 4));
+    memcpy(b->data + size_at, &size, 4);
+}
+
+static uint64_t ntp_now(int64_t offset_usec)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t usec = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + offset_usec;
+    uint64_t sec = (uint64_t)(usec / 1000000) + OSC_NTP_UNIX_OFFSET;
+    uint64_t frac = ((uint64_t)(usec % 1000000) << 32) / 1000000;
+    return sec << 32 | frac;
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 9000, rate = 200, count = 1000, stale_every = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:r:n:s:")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'r': rate = atoi(optarg); break;
+        case 'n': count = atoi(optarg); break;
+        case 's': stale_every = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-r rate_hz] [-n bundles] [-s stale_every]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rate < 1)
+        rate = 1;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (fd < 0)
+        return 1;
+
+    struct timespec period = {0, 1000000000L / rate};
+    int stale = 0;
+    for (int i = 0; i < count; i++) {
+        bool backdate = stale_every > 0 && i % stale_every == stale_every - 1;
+        float t = (float)i / (float)rate;
+        float aed[3] = {fmodf(t * 90.0f, 360.0f), 0.0f, 60.0f};
+        float ypr[3] = {30.0f * sinf(t), 0.0f, 0.0f};
+        OscBuffer b = {.len = 0};
+
+        put_string(&b, "#bundle");
+        uint64_t tt = ntp_now(backdate ? -1000000 : 0);
+        put_u32(&b, (uint32_t)(tt >> 32));
+        put_u32(&b, (uint32_t)tt);
+        put_message(&b, "/source/1/aed", aed, 3);
+        put_message(&b, "/listener/ypr", ypr, 3);
+
+        sendto(fd, b.data, b.len, 0, (const struct sockaddr *)&addr, sizeof(addr));
+        stale += backdate;
+        nanosleep(&period, NULL);
+    }
+
+    printf("sent %d bundles to 127.0.0.1:%d at %d Hz, %d backdated by 1 s\n", count, port, rate, stale);
+    close(fd);
+    return 0;
+}
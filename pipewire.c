@@ -2,8 +2,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include <pipewire/pipewire.h>
 #include <pipewire/keys.h>
+#include <pipewire/extensions/metadata.h>
+#include <spa/param/latency-utils.h>
 #include <spa/param/props.h>
 #include <spa/pod/builder.h>
 #include <spa/pod/parser.h>
@@ -13,28 +17,28 @@
 #include <spa/utils/dict.h>
 #include <math.h>
 #include "pipewire.h"
-#include "ui.h"
-
-static inline gpointer u32key(uint32_t id)
-{
-    return GUINT_TO_POINTER(id);
-}
+#include "control_socket.h"
+#include "osc_input.h"
+#include "shm_state.h"
+#include "ui_mailbox.h"
 
 static void set_source_label(AppData *app, int slot, const char *app_name);
 static void apply_connection_state(AppData *app, int slot);
+static void clock_probe_update(AppData *app);
 static void destroy_link(AppData *app, uint32_t link_id);
 static void cleanup_existing_filter_links(AppData *app);
-static struct pw_proxy *create_link(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid);
-static int set_source_bypass_internal(struct spa_loop *loop, bool async, uint32_t seq,
-                                      const void *data, size_t size, void *user_data);
-static int cleanup_links_task(struct spa_loop *loop, bool async, uint32_t seq,
-                              const void *data, size_t size, void *user_data);
-static void run_on_pw_loop(AppData *app, spa_invoke_func_t func, void *data, size_t size);
+static void create_link(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid);
+static void apply_source_bypass(AppData *app, int source_idx, bool bypass);
+static void reconcile_request(AppData *app);
+static void link_retry_reset_slot(AppData *app, int slot);
+static void mark_slot_dirty(AppData *app, int slot);
 static void set_slot_gain(AppData *data, int slot, float gain);
 static float mirror_azimuth(float az);
-static void send_sofa_control_force(AppData *data, int source_idx);
 static bool node_is_fixed_loudness(const NodeInfo *ni);
 static float random_slot_azimuth(const AppData *app, int slot);
+static void run_command(AppData *app, const Command *cmd);
+static void take_posted_controls(AppData *app);
+static void apply_control_values(AppData *app, const float values[CTL_COUNT], uint64_t mask);
 
 static float radius_to_gain(float radius_pct)
 {
@@ -61,31 +65,12 @@ static float mirror_azimuth(float az)
     return m;
 }
 
-static bool params_changed(const AudioSource *s, float az, float el, float rad, float width, float gain)
+/* The canvas draws from the mailbox copy of these; only this thread writes them */
+static void publish_canvas_slot(AppData *app, int slot)
 {
-    if (!s->last_valid)
-        return true;
-    if (fabsf(az - s->last_azimuth) > 0.25f)
-        return true;
-    if (fabsf(el - s->last_elevation) > 0.25f)
-        return true;
-    if (fabsf(rad - s->last_radius) > 0.25f)
-        return true;
-    if (fabsf(width - s->last_width) > 0.25f)
-        return true;
-    if (fabsf(gain - s->last_gain) > 0.05f)
-        return true;
-    return false;
-}
+    const AudioSource *src = &app->sources[slot];
 
-static void remember_params(AudioSource *s, float az, float el, float rad, float width, float gain)
-{
-    s->last_valid = true;
-    s->last_azimuth = az;
-    s->last_elevation = el;
-    s->last_radius = rad;
-    s->last_width = width;
-    s->last_gain = gain;
+    ui_mailbox_set_canvas_slot(&app->mailbox, slot, src->active, src->is_playing, src->app_label);
 }
 
 static void set_source_label(AppData *app, int slot, const char *app_name)
@@ -102,19 +87,17 @@ static void set_source_label(AppData *app, int slot, const char *app_name)
         app->sources[slot].app_label[0] = '\0';
     }
 
-    if (app->playing_labels[slot])
+    if (app->sources[slot].app_label[0] != '\0')
     {
-        if (app->sources[slot].app_label[0] != '\0')
-        {
-            char buf[160];
-            snprintf(buf, sizeof(buf), "Playing: %s", app->sources[slot].app_label);
-            gtk_label_set_text(GTK_LABEL(app->playing_labels[slot]), buf);
-        }
-        else
-        {
-            gtk_label_set_text(GTK_LABEL(app->playing_labels[slot]), "No audio");
-        }
+        char buf[160];
+        snprintf(buf, sizeof(buf), "Playing: %s", app->sources[slot].app_label);
+        ui_mailbox_set_playing(&app->mailbox, slot, buf);
+    }
+    else
+    {
+        ui_mailbox_set_playing(&app->mailbox, slot, "No audio");
     }
+    publish_canvas_slot(app, slot);
 }
 
 static void apply_connection_state(AppData *app, int slot)
@@ -126,6 +109,8 @@ static void apply_connection_state(AppData *app, int slot)
     int base = slot * 2;
     bool connected = false;
 
+    clock_probe_update(app);
+
     if (base >= 0 && base + 1 < 8)
     {
         connected = app->filter_in_occupied[base] || app->filter_in_occupied[base + 1];
@@ -141,20 +126,10 @@ static void apply_connection_state(AppData *app, int slot)
         return;
 
     app->sources[slot].is_playing = connected;
+    publish_canvas_slot(app, slot);
 
-    if (app->elevation_sliders[slot])
-    {
-        gtk_widget_set_sensitive(app->elevation_sliders[slot], connected);
-    }
-    if (app->width_sliders[slot])
-    {
-        gtk_widget_set_sensitive(app->width_sliders[slot], connected);
-    }
-    if (app->bypass_checkboxes[slot])
-    {
-        /* Allow pre-arming bypass even when no stream is currently linked. */
-        gtk_widget_set_sensitive(app->bypass_checkboxes[slot], app->sources[slot].active);
-    }
+    /* Allow pre-arming bypass even when no stream is currently linked. */
+    ui_mailbox_set_sensitivity(&app->mailbox, slot, connected, app->sources[slot].active);
 
     if (!connected)
     {
@@ -163,14 +138,16 @@ static void apply_connection_state(AppData *app, int slot)
         app->sources[slot].fixed_loudness = false;
         app->sources[slot].source_node_id = 0;
         app->sources[slot].initial_position_set = false;
+        app->sources[slot].seed_from_filter = false;
     }
 
     if (connected && !was_playing && !app->sources[slot].initial_position_set)
     {
+        g_mutex_lock(&app->positions_lock);
         app->sources[slot].azimuth = random_slot_azimuth(app, slot);
+        g_mutex_unlock(&app->positions_lock);
         app->sources[slot].initial_position_set = true;
-        send_sofa_control_force(app, slot);
-        refresh_canvas(app);
+        send_sofa_control(app, slot);
     }
 
     if (!connected && app->active_source == slot)
@@ -178,7 +155,209 @@ static void apply_connection_state(AppData *app, int slot)
         app->active_source = -1;
     }
 
-    refresh_canvas(app);
+    ui_mailbox_queue_redraw(&app->mailbox);
+}
+
+#define LINK_OP_TIMEOUT_USEC   (2 * G_USEC_PER_SEC)
+#define LINK_OP_SWEEP_NSEC     (250 * 1000000L)
+#define LINK_RETRY_MAX         5
+#define LINK_RETRY_BASE_USEC   (250 * 1000)   /* doubles per create: 0.25, 0.5, 1, 2 s */
+#define LINK_RETRY_WINDOW_USEC (10 * G_USEC_PER_SEC)
+#define SEED_TIMEOUT_USEC      (2 * G_USEC_PER_SEC)   /* adopted slots wait this long for the read-back */
+
+/* Lives in the user data of a link-factory proxy */
+struct link_op_proxy
+{
+    AppData *app;
+    uint32_t op_id;
+    struct spa_hook listener;
+};
+
+static void link_op_timer_arm(AppData *app)
+{
+    if (app->link_op_timer_armed || !app->link_op_timer)
+        return;
+
+    struct timespec value = {0, LINK_OP_SWEEP_NSEC};
+    struct timespec interval = {0, LINK_OP_SWEEP_NSEC};
+    pw_loop_update_timer(pw_main_loop_get_loop(app->loop), app->link_op_timer, &value, &interval, false);
+    app->link_op_timer_armed = true;
+}
+
+static void link_op_timer_disarm(AppData *app)
+{
+    if (!app->link_op_timer_armed)
+        return;
+
+    struct timespec off = {0, 0};
+    pw_loop_update_timer(pw_main_loop_get_loop(app->loop), app->link_op_timer, &off, &off, false);
+    app->link_op_timer_armed = false;
+}
+
+static uint32_t link_op_start(AppData *app, LinkOpType type, LinkOp **out)
+{
+    uint32_t op_id = ++app->next_link_op;
+    if (op_id == FLATMAP_EMPTY || op_id == 0)
+        op_id = app->next_link_op = 1;
+
+    LinkOp *op = flatmap_insert(&app->link_ops, op_id);
+    if (!op)
+        return 0;
+    op->type = type;
+    op->start_usec = g_get_monotonic_time();
+
+    LinkOpStats *st = type == LINK_OP_CREATE ? &app->link_create_stats : &app->link_destroy_stats;
+    st->issued++;
+    link_op_timer_arm(app);
+
+    *out = op;
+    return op_id;
+}
+
+/* Records the outcome of an operation; res is 0 on success or a negative errno */
+static void link_op_finish(AppData *app, uint32_t op_id, LinkOp *op, int res)
+{
+    if (op->finished)
+        return;
+
+    op->finished = true;
+    op->result = res;
+
+    LinkOpStats *st = op->type == LINK_OP_CREATE ? &app->link_create_stats : &app->link_destroy_stats;
+    uint64_t elapsed = (uint64_t)(g_get_monotonic_time() - op->start_usec);
+    const char *what = op->type == LINK_OP_CREATE ? "create" : "destroy";
+
+    if (res < 0)
+    {
+        st->failed++;
+        fprintf(stderr, "[linkop] %s #%u failed after %.1f ms: %s\n",
+                what, op_id, elapsed / 1000.0, spa_strerror(res));
+        /* The reconciler retries it, subject to the edge's backoff */
+        if (op->type == LINK_OP_CREATE)
+            reconcile_request(app);
+        return;
+    }
+
+    st->completed++;
+    st->total_usec += elapsed;
+    if (elapsed > st->max_usec)
+        st->max_usec = elapsed;
+
+    printf("[linkop] %s #%u link %u done in %.1f ms (avg %.1f ms, max %.1f ms over %llu)\n",
+           what, op_id, op->link_id, elapsed / 1000.0,
+           st->total_usec / 1000.0 / st->completed, st->max_usec / 1000.0,
+           (unsigned long long)st->completed);
+}
+
+static void link_op_proxy_destroy(void *data)
+{
+    struct link_op_proxy *pd = data;
+
+    spa_hook_remove(&pd->listener);
+    flatmap_remove(&pd->app->link_ops, pd->op_id);
+}
+
+static void link_op_proxy_bound(void *data, uint32_t global_id)
+{
+    struct link_op_proxy *pd = data;
+    LinkOp *op = flatmap_lookup(&pd->app->link_ops, pd->op_id);
+    if (!op)
+        return;
+
+    op->link_id = global_id;
+    link_op_finish(pd->app, pd->op_id, op, 0);
+}
+
+static void link_op_proxy_removed(void *data)
+{
+    struct link_op_proxy *pd = data;
+    LinkOp *op = flatmap_lookup(&pd->app->link_ops, pd->op_id);
+    if (op)
+        link_op_finish(pd->app, pd->op_id, op, -ENOENT);
+}
+
+static void link_op_proxy_error(void *data, int seq, int res, const char *message)
+{
+    struct link_op_proxy *pd = data;
+    LinkOp *op = flatmap_lookup(&pd->app->link_ops, pd->op_id);
+
+    fprintf(stderr, "[linkop] create #%u error: %s\n", pd->op_id, message ? message : "(none)");
+    if (op)
+        link_op_finish(pd->app, pd->op_id, op, res < 0 ? res : -EIO);
+}
+
+static const struct pw_proxy_events link_op_proxy_events = {
+    PW_VERSION_PROXY_EVENTS,
+    .destroy = link_op_proxy_destroy,
+    .bound = link_op_proxy_bound,
+    .removed = link_op_proxy_removed,
+    .error = link_op_proxy_error,
+};
+
+/* Called from global_remove; completes a destroy issued by destroy_link() */
+static void link_op_link_removed(AppData *app, uint32_t link_id)
+{
+    uint32_t *op_id = flatmap_lookup(&app->link_destroy_ops, link_id);
+    if (!op_id)
+        return;
+
+    LinkOp *op = flatmap_lookup(&app->link_ops, *op_id);
+    if (op)
+    {
+        link_op_finish(app, *op_id, op, 0);
+        flatmap_remove(&app->link_ops, *op_id);
+    }
+    flatmap_remove(&app->link_destroy_ops, link_id);
+}
+
+/* Releases finished create proxies and gives up on operations past the timeout */
+static void on_link_op_timer(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    AppData *app = data;
+    gint64 now = g_get_monotonic_time();
+    uint32_t ids[64];
+    uint32_t n = 0;
+
+    FlatMapIter iter;
+    uint32_t key;
+    void *value;
+    flatmap_iter_init(&iter, &app->link_ops);
+    while (n < 64 && flatmap_iter_next(&iter, &key, &value))
+    {
+        LinkOp *op = value;
+        if (op->finished || now - op->start_usec > LINK_OP_TIMEOUT_USEC)
+            ids[n++] = key;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        LinkOp *op = flatmap_lookup(&app->link_ops, ids[i]);
+        if (!op)
+            continue;
+
+        if (!op->finished)
+        {
+            LinkOpStats *st = op->type == LINK_OP_CREATE ? &app->link_create_stats : &app->link_destroy_stats;
+            st->timed_out++;
+            fprintf(stderr, "[linkop] %s #%u timed out (link %u, %llu timed out so far)\n",
+                    op->type == LINK_OP_CREATE ? "create" : "destroy", ids[i], op->link_id,
+                    (unsigned long long)st->timed_out);
+            if (op->type == LINK_OP_CREATE)
+                reconcile_request(app);
+        }
+
+        if (op->type == LINK_OP_DESTROY)
+            flatmap_remove(&app->link_destroy_ops, op->link_id);
+
+        if (op->proxy)
+            pw_proxy_destroy(op->proxy);  /* the destroy event drops the entry */
+        else
+            flatmap_remove(&app->link_ops, ids[i]);
+    }
+
+    if (flatmap_count(&app->link_ops) == 0)
+        link_op_timer_disarm(app);
 }
 
 static void destroy_link(AppData *app, uint32_t link_id)
@@ -195,42 +374,45 @@ static void destroy_link(AppData *app, uint32_t link_id)
     {
         fprintf(stderr, "[linkmgr] pw_registry_destroy(%u) failed: %d (%s)\n",
                 link_id, res, spa_strerror(res));
+        return;
     }
+
+    if (flatmap_lookup(&app->link_destroy_ops, link_id))
+        return;
+
+    LinkOp *op;
+    uint32_t op_id = link_op_start(app, LINK_OP_DESTROY, &op);
+    if (!op_id)
+        return;
+    op->link_id = link_id;
+
+    uint32_t *slot = flatmap_insert(&app->link_destroy_ops, link_id);
+    if (slot)
+        *slot = op_id;
 }
 
-static NodeInfo *node_info_new(const struct spa_dict *props)
+static void node_info_fill(AppData *app, NodeInfo *ni, const struct spa_dict *props)
 {
-    NodeInfo *ni = g_new0(NodeInfo, 1);
-    const char *node_name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
-    const char *node_desc = spa_dict_lookup(props, PW_KEY_NODE_DESCRIPTION);
-    const char *app_name = spa_dict_lookup(props, PW_KEY_APP_NAME);
-    const char *media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
-    const char *icon = spa_dict_lookup(props, PW_KEY_APP_ICON_NAME);
+    StrPool *pool = &app->strings;
 
-    if (node_name)
-        ni->name = g_strdup(node_name);
-    if (node_desc)
-        ni->desc = g_strdup(node_desc);
-    if (app_name)
-        ni->app_name = g_strdup(app_name);
-    if (media_class)
-        ni->media_class = g_strdup(media_class);
-    if (icon)
-        ni->icon_name = g_strdup(icon);
-    return ni;
+    ni->name = strpool_intern(pool, spa_dict_lookup(props, PW_KEY_NODE_NAME));
+    ni->desc = strpool_intern(pool, spa_dict_lookup(props, PW_KEY_NODE_DESCRIPTION));
+    ni->app_name = strpool_intern(pool, spa_dict_lookup(props, PW_KEY_APP_NAME));
+    ni->media_class = strpool_intern(pool, spa_dict_lookup(props, PW_KEY_MEDIA_CLASS));
+    ni->icon_name = strpool_intern(pool, spa_dict_lookup(props, PW_KEY_APP_ICON_NAME));
 }
 
-static void node_info_free(gpointer data)
+/* Drops the string references of an inline NodeInfo; the entry itself lives in app->nodes */
+static void node_info_clear(AppData *app, NodeInfo *ni)
 {
-    NodeInfo *ni = data;
-    if (!ni)
-        return;
-    g_free(ni->name);
-    g_free(ni->desc);
-    g_free(ni->app_name);
-    g_free(ni->media_class);
-    g_free(ni->icon_name);
-    g_free(ni);
+    StrPool *pool = &app->strings;
+
+    strpool_release(pool, ni->name);
+    strpool_release(pool, ni->desc);
+    strpool_release(pool, ni->app_name);
+    strpool_release(pool, ni->media_class);
+    strpool_release(pool, ni->icon_name);
+    memset(ni, 0, sizeof(*ni));
 }
 
 static const char *node_label(NodeInfo *ni)
@@ -264,6 +446,7 @@ static bool node_is_fixed_loudness(const NodeInfo *ni)
     return false;
 }
 
+/* Caller holds positions_lock */
 static float random_slot_azimuth(const AppData *app, int slot)
 {
     const float min_sep = 18.0f;
@@ -301,12 +484,15 @@ static float random_slot_azimuth(const AppData *app, int slot)
     return best;
 }
 
-static void replace_node_info(AppData *app, uint32_t id, NodeInfo *ni)
+static void replace_node_info(AppData *app, uint32_t id, const struct spa_dict *props)
 {
-    NodeInfo *old = g_hash_table_lookup(app->nodes, u32key(id));
-    if (old)
-        node_info_free(old);
-    g_hash_table_replace(app->nodes, u32key(id), ni);
+    NodeInfo *ni = flatmap_insert(&app->nodes, id);
+    if (!ni)
+        return;
+    /* Intern the new strings before releasing the old ones so unchanged values keep their entry */
+    NodeInfo old = *ni;
+    node_info_fill(app, ni, props);
+    node_info_clear(app, &old);
 }
 
 static uint32_t find_source_node_id(const AppData *app, int slot)
@@ -316,218 +502,188 @@ static uint32_t find_source_node_id(const AppData *app, int slot)
     return app->sources[slot].source_node_id;
 }
 
+/* Packs (node, direction, port.id) into the key used by app->port_index */
+static uint64_t port_index_key(uint32_t node_id, int direction, int port_id)
+{
+    return ((uint64_t)node_id << 32) |
+           ((uint64_t)(direction & 1) << 31) |
+           ((uint64_t)port_id & 0x7fffffffu);
+}
+
+static void port_index_insert(AppData *app, const PortInfo *pi)
+{
+    uint32_t *gid = flatmap64_insert(&app->port_index,
+                                     port_index_key(pi->node_id, pi->direction, pi->port_id));
+    if (gid)
+        *gid = pi->global_id;
+}
+
+static void port_index_remove(AppData *app, const PortInfo *pi)
+{
+    uint64_t key = port_index_key(pi->node_id, pi->direction, pi->port_id);
+
+    /* Only drop the entry if a newer port has not taken over the key */
+    const uint32_t *gid = flatmap64_lookup(&app->port_index, key);
+    if (gid && *gid == pi->global_id)
+        flatmap64_remove(&app->port_index, key);
+}
+
+static uint32_t port_index_lookup(const AppData *app, uint32_t node_id, int direction, int port_id)
+{
+    const uint32_t *gid = flatmap64_lookup(&app->port_index, port_index_key(node_id, direction, port_id));
+    return gid ? *gid : 0;
+}
+
 static uint32_t find_sink_input_gid(const AppData *app, uint32_t sink_node_id, int port_id)
 {
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, app->ports);
-    while (g_hash_table_iter_next(&iter, &key, &value))
-    {
-        PortInfo *pi = value;
-        if (pi->node_id == sink_node_id && pi->direction == 0 && pi->port_id == port_id)
-        {
-            return pi->global_id;
-        }
-    }
-    return 0;
+    return port_index_lookup(app, sink_node_id, 0, port_id);
 }
 
 static uint32_t find_source_output_gid(const AppData *app, uint32_t src_node_id, int port_id)
 {
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, app->ports);
-    while (g_hash_table_iter_next(&iter, &key, &value))
-    {
-        PortInfo *pi = value;
-        if (pi->node_id == src_node_id && pi->direction == 1 && pi->port_id == port_id)
-        {
-            return pi->global_id;
-        }
-    }
-    return 0;
+    return port_index_lookup(app, src_node_id, 1, port_id);
 }
 
-static void destroy_links_from_node(AppData *app, uint32_t node_id)
+static void link_table_remove(AppData *app, uint32_t link_id)
 {
-    GHashTableIter iter;
-    gpointer key, value;
-    GList *to_destroy = NULL;
+    LinkInfo *li = flatmap_lookup(&app->links, link_id);
+    if (!li)
+        return;
 
-    g_hash_table_iter_init(&iter, app->links);
-    while (g_hash_table_iter_next(&iter, &key, &value))
+    /* Unhook from the output node's link list */
+    if (li->node_prev)
     {
-        LinkInfo *li = value;
-        if (li->out_node_id == node_id)
-        {
-            if (li->filter_in_port_id >= 0 && li->filter_in_port_id < 8)
-            {
-                app->filter_in_occupied[li->filter_in_port_id] = false;
-            }
-            to_destroy = g_list_prepend(to_destroy, GUINT_TO_POINTER(li->link_id));
-        }
+        LinkInfo *prev = flatmap_lookup(&app->links, li->node_prev);
+        if (prev)
+            prev->node_next = li->node_next;
+    }
+    else if (li->node_next)
+    {
+        uint32_t *head = flatmap_insert(&app->node_links, li->out_node_id);
+        if (head)
+            *head = li->node_next;
+    }
+    else
+    {
+        flatmap_remove(&app->node_links, li->out_node_id);
     }
 
-    for (GList *l = to_destroy; l; l = l->next)
+    if (li->node_next)
     {
-        uint32_t lid = GPOINTER_TO_UINT(l->data);
-        g_hash_table_remove(app->links, u32key(lid));
-        destroy_link(app, lid);
+        LinkInfo *next = flatmap_lookup(&app->links, li->node_next);
+        if (next)
+            next->node_prev = li->node_prev;
     }
-    g_list_free(to_destroy);
+
+    flatmap_remove(&app->links, link_id);
 }
 
-static void create_sink_links(AppData *app, int slot)
+static void link_table_insert(AppData *app, const LinkInfo *info)
 {
-    uint32_t src_node = find_source_node_id(app, slot);
-    if (!src_node || app->default_sink_node_id == 0)
+    link_table_remove(app, info->link_id);
+
+    /* Push to the front of the output node's link list */
+    uint32_t *head = flatmap_insert(&app->node_links, info->out_node_id);
+    if (!head)
         return;
+    uint32_t first_id = *head;
+    *head = info->link_id;
 
-    for (int ch = 0; ch < 2; ch++)
+    if (first_id)
     {
-        uint32_t out_gid = find_source_output_gid(app, src_node, ch);
-        uint32_t in_gid = find_sink_input_gid(app, app->default_sink_node_id, ch);
-        if (out_gid && in_gid)
-        {
-            create_link(app, out_gid, in_gid);
-        }
+        LinkInfo *first = flatmap_lookup(&app->links, first_id);
+        if (first)
+            first->node_prev = info->link_id;
     }
+
+    LinkInfo *li = flatmap_insert(&app->links, info->link_id);
+    if (!li)
+        return;
+    *li = *info;
+    li->node_prev = 0;
+    li->node_next = first_id;
 }
 
-static void create_filter_links(AppData *app, int slot)
+static void post_command(AppData *app, CommandType type, int source_idx, uint32_t flag)
 {
-    uint32_t src_node = find_source_node_id(app, slot);
-    if (!src_node || app->filter_node_id == 0)
+    if (!app || !app->loop || !app->command_event)
         return;
 
-    int base_input = slot * 2;
-    for (int ch = 0; ch < 2; ch++)
+    Command cmd = {
+        .type = type,
+        .source_idx = source_idx,
+        .flag = flag,
+    };
+
+    /* Callers on the PipeWire thread (control socket, daemon) apply in place */
+    if (g_thread_self() == app->pw_thread)
     {
-        uint32_t out_gid = find_source_output_gid(app, src_node, ch);
-        uint32_t in_gid = app->filter_in_gid[base_input + ch];
-        if (out_gid && in_gid)
-        {
-            create_link(app, out_gid, in_gid);
-            app->filter_in_occupied[base_input + ch] = true;
-        }
+        run_command(app, &cmd);
+        return;
+    }
+
+    if (!command_ring_push(&app->commands, &cmd))
+    {
+        fprintf(stderr, "[cmd] command ring full, dropping command %u\n", cmd.type);
+        return;
     }
+    pw_loop_signal_event(pw_main_loop_get_loop(app->loop), app->command_event);
 }
 
 void relink_stereo_to_filter(AppData *app, int source_idx)
 {
-    struct
-    {
-        AppData *a;
-        int idx;
-        bool bp;
-    } payload = {app, source_idx, false};
-    run_on_pw_loop(app, set_source_bypass_internal, &payload, sizeof(payload));
+    post_command(app, CMD_RELINK, source_idx, 0);
 }
 
 void unlink_all_filter_inputs(AppData *app)
 {
-    AppData *payload = app;
-    run_on_pw_loop(app, cleanup_links_task, &payload, sizeof(payload));
+    post_command(app, CMD_CLEANUP_LINKS, -1, 0);
 }
 
 void set_source_bypass(AppData *app, int source_idx, bool bypass)
 {
-    struct
-    {
-        AppData *a;
-        int idx;
-        bool bp;
-    } payload = {app, source_idx, bypass};
-    run_on_pw_loop(app, set_source_bypass_internal, &payload, sizeof(payload));
+    post_command(app, CMD_SET_BYPASS, source_idx, bypass ? 1 : 0);
 }
 
-static int set_source_bypass_internal(struct spa_loop *loop, bool async, uint32_t seq,
-                                      const void *data, size_t size, void *user_data)
+void assign_source_slot(AppData *app, int slot, uint32_t node_id)
 {
-    (void)loop;
-    (void)async;
-    (void)seq;
-    (void)size;
-    (void)user_data;
-    const struct
-    {
-        AppData *a;
-        int idx;
-        bool bp;
-    } *p = data;
-    AppData *app = p->a;
-    int source_idx = p->idx;
-    bool bypass = p->bp;
+    post_command(app, CMD_ASSIGN_SLOT, slot, node_id);
+}
 
+static void apply_source_bypass(AppData *app, int source_idx, bool bypass)
+{
     if (!app || source_idx < 0 || source_idx >= MAX_SOURCES)
-        return 0;
+        return;
 
-    bool was_bypassed = app->sources[source_idx].bypass;
     app->sources[source_idx].bypass = bypass;
+    link_retry_reset_slot(app, source_idx);
 
-    destroy_links_from_node(app, find_source_node_id(app, source_idx));
+    /* The next commit rewires the links and then applies the connection state */
+    reconcile_request(app);
+    mark_slot_dirty(app, source_idx);
     if (bypass)
     {
-        create_sink_links(app, source_idx);
         app->sources[source_idx].is_playing = true;
-        app->sources[source_idx].last_valid = false;
+        publish_canvas_slot(app, source_idx);
     }
     else
-    {
-        create_filter_links(app, source_idx);
-        int base = source_idx * 2;
-        if (app->filter_in_gid[base])
-            app->filter_in_occupied[base] = true;
-        if (app->filter_in_gid[base + 1])
-            app->filter_in_occupied[base + 1] = true;
-        apply_connection_state(app, source_idx);
-        if (was_bypassed)
-        {
-            send_sofa_control_force(app, source_idx);
-        }
-        else
-        {
-            send_sofa_control(app, source_idx);
-        }
-    }
-    apply_connection_state(app, source_idx);
-    return 0;
-}
-
-static int cleanup_links_task(struct spa_loop *loop, bool async, uint32_t seq,
-                              const void *data, size_t size, void *user_data)
-{
-    (void)loop;
-    (void)async;
-    (void)seq;
-    (void)size;
-    (void)user_data;
-    AppData *app = *(AppData *const *)data;
-    cleanup_existing_filter_links(app);
-    return 0;
+        send_sofa_control(app, source_idx);
 }
 
-static void run_on_pw_loop(AppData *app, spa_invoke_func_t func, void *data, size_t size)
-{
-    if (!app || !app->loop)
-        return;
-    pw_loop_invoke(pw_main_loop_get_loop(app->loop), func, 0, data, size, true, NULL);
-}
 static void cleanup_existing_filter_links(AppData *app)
 {
-    GHashTableIter iter;
-    gpointer key, value;
+    FlatMapIter iter;
+    void *value;
 
     printf("[startup] cleaning up existing links into spatializer\n");
 
-    g_hash_table_iter_init(&iter, app->links);
+    flatmap_iter_init(&iter, &app->links);
 
-    while (g_hash_table_iter_next(&iter, &key, &value))
+    while (flatmap_iter_next(&iter, NULL, &value))
     {
         LinkInfo *li = value;
 
-        PortInfo *in_pi =
-            g_hash_table_lookup(app->ports, u32key(li->in_port_gid));
+        PortInfo *in_pi = flatmap_lookup(&app->ports, li->in_port_gid);
 
         if (!in_pi)
             continue;
@@ -553,29 +709,50 @@ static void cleanup_existing_filter_links(AppData *app)
     }
 }
 
-static struct pw_proxy *create_link(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid)
+static void create_link(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid)
 {
     if (!app->core)
-        return NULL;
+        return;
 
     char out_port_str[16], in_port_str[16];
     snprintf(out_port_str, sizeof(out_port_str), "%u", out_port_gid);
     snprintf(in_port_str, sizeof(in_port_str), "%u", in_port_gid);
 
+    /* Linger so the link survives once the proxy is released after "bound" */
     const struct spa_dict_item items[] = {
         {PW_KEY_LINK_OUTPUT_PORT, out_port_str},
         {PW_KEY_LINK_INPUT_PORT, in_port_str},
+        {PW_KEY_OBJECT_LINGER, "true"},
     };
     struct spa_dict dict = SPA_DICT_INIT(items, (uint32_t)(sizeof(items) / sizeof(items[0])));
 
     printf("[linkmgr] creating link out_port=%u -> in_port=%u\n", out_port_gid, in_port_gid);
 
-    return pw_core_create_object(app->core,
-                                 "link-factory",
-                                 PW_TYPE_INTERFACE_Link,
-                                 PW_VERSION_LINK,
-                                 &dict,
-                                 0);
+    LinkOp *op;
+    uint32_t op_id = link_op_start(app, LINK_OP_CREATE, &op);
+    if (!op_id)
+        return;
+    op->out_port_gid = out_port_gid;
+    op->in_port_gid = in_port_gid;
+
+    struct pw_proxy *proxy = pw_core_create_object(app->core,
+                                                   "link-factory",
+                                                   PW_TYPE_INTERFACE_Link,
+                                                   PW_VERSION_LINK,
+                                                   &dict,
+                                                   sizeof(struct link_op_proxy));
+    if (!proxy)
+    {
+        link_op_finish(app, op_id, op, -errno);
+        flatmap_remove(&app->link_ops, op_id);
+        return;
+    }
+    op->proxy = proxy;
+
+    struct link_op_proxy *pd = pw_proxy_get_user_data(proxy);
+    pd->app = app;
+    pd->op_id = op_id;
+    pw_proxy_add_listener(proxy, &pd->listener, &link_op_proxy_events, pd);
 }
 
 static int find_or_allocate_stereo_slot(AppData *app, uint32_t out_node_id)
@@ -619,190 +796,1810 @@ static void free_stereo_slot(AppData *app, uint32_t out_node_id)
     }
 }
 
-struct param_data
+static int find_stereo_slot(const AppData *app, uint32_t out_node_id)
 {
-    struct pw_proxy *proxy;
-    char name[64];
-    float value;
-};
+    for (int i = 0; i < MAX_STEREO_SLOTS; i++)
+    {
+        if (app->stereo_slots[i].occupied &&
+            app->stereo_slots[i].out_node_id == out_node_id)
+            return i;
+    }
+    return -1;
+}
 
-static int do_set_param(struct spa_loop *loop, bool async, uint32_t seq,
-                        const void *data, size_t size, void *user_data)
+/*
+ * Registry events are handled in two phases. Ingest only records what was
+ * observed and marks work (reconcile_request(), mark_slot_dirty()); the
+ * done of the next pw_core_sync runs commit_registry() once per burst.
+ */
+static void schedule_commit(AppData *app)
 {
-    (void)loop;
-    (void)async;
-    (void)seq;
-    (void)size;
-    (void)user_data;
-
-    const struct param_data *pd = data;
+    if (app->commit_seq != 0 || !app->core)
+        return;
 
-    uint8_t buffer[1024];
-    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
-    struct spa_pod_frame f, f_struct;
+    int seq = pw_core_sync(app->core, PW_ID_CORE, 0);
+    app->commit_seq = seq > 0 ? seq : 0;
+}
 
-    spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
-    spa_pod_builder_prop(&b, SPA_PROP_params, 0);
-    spa_pod_builder_push_struct(&b, &f_struct);
-    spa_pod_builder_string(&b, pd->name);
-    spa_pod_builder_float(&b, pd->value);
-    spa_pod_builder_pop(&b, &f_struct);
-    spa_pod_builder_pop(&b, &f);
+static void mark_slot_dirty(AppData *app, int slot)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+    app->dirty_slots |= 1u << slot;
+    schedule_commit(app);
+}
 
-    struct spa_pod *pod = spa_pod_builder_deref(&b, 0);
-    pw_node_set_param((struct pw_node *)pd->proxy, SPA_PARAM_Props, 0, pod);
+/*
+ * Link reconciler. reconcile_links() compares the desired graph (slot
+ * source -> filter inputs slot*2+ch, or -> default sink when bypassed)
+ * against app->links and applies the difference.
+ */
+static void reconcile_request(AppData *app)
+{
+    app->reconcile.requests++;
+    app->reconcile_pending = true;
+    schedule_commit(app);
+}
 
-    return 0;
+/* Links into the filter or the default sink are ours to manage; anything else is left alone */
+static bool link_is_managed(const AppData *app, const LinkInfo *li)
+{
+    PortInfo *in_pi = flatmap_lookup(&app->ports, li->in_port_gid);
+    if (!in_pi || in_pi->direction != 0)
+        return false;
+    if (app->filter_node_id != 0 && in_pi->node_id == app->filter_node_id)
+        return true;
+    return app->default_sink_node_id != 0 && in_pi->node_id == app->default_sink_node_id;
 }
 
-static void set_slot_gain(AppData *data, int slot, float gain)
+static void reconcile_destroy(AppData *app, uint32_t link_id)
 {
-    if (!data || !data->filter_proxy)
-        return;
-    if (slot < 0 || slot >= MAX_SOURCES)
-        return;
+    /* Forget it first so the global_remove does not touch slot state */
+    link_table_remove(app, link_id);
+    destroy_link(app, link_id);
+}
 
-    struct param_data pd_gain;
-    pd_gain.proxy = data->filter_proxy;
-    int base_channel = slot * 2;
+/* A create for this edge was issued and has no result yet; once bound, the link is in app->links */
+static bool link_create_in_flight(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid)
+{
+    FlatMapIter iter;
+    void *value;
 
-    for (int i = 0; i < 2; i++)
+    flatmap_iter_init(&iter, &app->link_ops);
+    while (flatmap_iter_next(&iter, NULL, &value))
     {
-        int channel_id = base_channel + i + 1; /* 1..8 */
+        const LinkOp *op = value;
+        if (op->type != LINK_OP_CREATE || op->out_port_gid != out_port_gid || op->in_port_gid != in_port_gid)
+            continue;
+        if (!op->finished)
+            return true;
+    }
+    return false;
+}
 
-        snprintf(pd_gain.name, sizeof(pd_gain.name), "mixL:Gain %d", channel_id);
-        pd_gain.value = gain;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_gain, sizeof(pd_gain), false, NULL);
+static void on_link_retry_timer(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    AppData *app = data;
 
-        snprintf(pd_gain.name, sizeof(pd_gain.name), "mixR:Gain %d", channel_id);
-        pd_gain.value = gain;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_gain, sizeof(pd_gain), false, NULL);
-    }
+    app->link_retry_due = 0;
+    reconcile_request(app);
 }
 
-static void send_sofa_control_force(AppData *data, int source_idx)
+static void link_retry_wake_at(AppData *app, gint64 due)
 {
-    if (!data)
+    if (!app->link_retry_timer || (app->link_retry_due && app->link_retry_due <= due))
         return;
-    data->sources[source_idx].last_valid = false;
-    data->sources[source_idx].last_sofa_usec = 0;
-    send_sofa_control(data, source_idx);
+
+    gint64 delay = MAX(due - g_get_monotonic_time(), 1);
+    struct timespec value = {delay / G_USEC_PER_SEC, (long)(delay % G_USEC_PER_SEC) * 1000};
+    pw_loop_update_timer(pw_main_loop_get_loop(app->loop), app->link_retry_timer, &value, NULL, false);
+    app->link_retry_due = due;
 }
 
-void send_sofa_control(AppData *data, int source_idx)
+/*
+ * Rate limit for recreating one edge: a create that keeps failing, or a
+ * session manager that keeps removing the link, is retried with a doubling
+ * backoff and given up after LINK_RETRY_MAX creates in a row. Creates more
+ * than LINK_RETRY_WINDOW_USEC apart start a new count.
+ */
+static bool link_create_allowed(AppData *app, uint32_t out_port_gid, uint32_t in_port_gid)
 {
-    if (!data->sources[source_idx].active || !data->filter_proxy)
-        return;
+    gint64 now = g_get_monotonic_time();
+    LinkRetry *r = flatmap_insert(&app->link_retries, out_port_gid);
 
-    const char *left_names[] = {"spk1", "spk3", "spk5", "spk7"};
-    const char *right_names[] = {"spk2", "spk4", "spk6", "spk8"};
-    if (source_idx < 0 || source_idx >= 4)
-        return;
+    if (!r)
+        return true;
+    if (r->in_port_gid != in_port_gid)
+        *r = (LinkRetry){.in_port_gid = in_port_gid};
+    if (r->gave_up)
+        return false;
 
-    if (data->sources[source_idx].bypass)
+    if (r->attempts > 0 && now - r->last_usec > LINK_RETRY_WINDOW_USEC)
+        r->attempts = 0;
+    if (r->attempts > 0)
     {
-        /* When bypassing, skip parameter updates */
-        return;
-    }
+        if (r->attempts >= LINK_RETRY_MAX)
+        {
+            r->gave_up = true;
+            fprintf(stderr, "[reconcile] giving up on link %u -> %u after %u creates; "
+                            "reassign the slot or toggle bypass to retry\n",
+                    out_port_gid, in_port_gid, r->attempts);
+            return false;
+        }
+
+        gint64 due = r->last_usec + (LINK_RETRY_BASE_USEC << (r->attempts - 1));
+        if (now < due)
+        {
+            link_retry_wake_at(app, due);
+            return false;
+        }
+    }
+
+    r->attempts++;
+    r->last_usec = now;
+    return true;
+}
+
+/* An explicit slot change gives the slot's edges a fresh retry budget */
+static void link_retry_reset_slot(AppData *app, int slot)
+{
+    uint32_t node_id = app->stereo_slots[slot].out_node_id;
+
+    for (int ch = 0; ch < 2 && node_id; ch++)
+    {
+        uint32_t out_gid = find_source_output_gid(app, node_id, ch);
+        if (out_gid)
+            flatmap_remove(&app->link_retries, out_gid);
+    }
+}
+
+static void reconcile_slot(AppData *app, int slot, uint32_t *created, uint32_t *destroyed, uint32_t *kept)
+{
+    uint32_t node_id = app->stereo_slots[slot].out_node_id;
+    bool bypass = app->sources[slot].bypass;
+    uint32_t want_out[2], want_in[2];
+    bool have[2] = {false, false};
+
+    for (int ch = 0; ch < 2; ch++)
+    {
+        want_out[ch] = find_source_output_gid(app, node_id, ch);
+        if (bypass)
+            want_in[ch] = app->default_sink_node_id ? find_sink_input_gid(app, app->default_sink_node_id, ch) : 0;
+        else
+            want_in[ch] = app->filter_in_gid[slot * 2 + ch];
+    }
+
+    uint32_t *head = flatmap_lookup(&app->node_links, node_id);
+    uint32_t lid = head ? *head : 0;
+
+    while (lid)
+    {
+        LinkInfo *li = flatmap_lookup(&app->links, lid);
+        if (!li)
+            break;
+        uint32_t next = li->node_next;
+
+        int ch = -1;
+        for (int c = 0; c < 2; c++)
+        {
+            if (want_out[c] && li->out_port_gid == want_out[c] && li->in_port_gid == want_in[c])
+                ch = c;
+        }
+
+        if (ch >= 0 && !have[ch])
+        {
+            have[ch] = true;
+            li->filter_in_port_id = bypass ? -1 : slot * 2 + ch;
+            (*kept)++;
+        }
+        else if (link_is_managed(app, li))
+        {
+            printf("[reconcile] slot %d: removing link id=%u (%u -> %u)\n",
+                   slot, lid, li->out_port_gid, li->in_port_gid);
+            reconcile_destroy(app, lid);
+            (*destroyed)++;
+        }
+        lid = next;
+    }
+
+    for (int ch = 0; ch < 2; ch++)
+    {
+        if (!have[ch] && want_out[ch] && want_in[ch])
+        {
+            /* A pending create is not repeated; the verify pass after it must not stack another */
+            if (link_create_in_flight(app, want_out[ch], want_in[ch]))
+            {
+                have[ch] = true;
+            }
+            else if (link_create_allowed(app, want_out[ch], want_in[ch]))
+            {
+                create_link(app, want_out[ch], want_in[ch]);
+                (*created)++;
+                have[ch] = true;
+            }
+        }
+        app->filter_in_occupied[slot * 2 + ch] = !bypass && have[ch];
+    }
+}
+
+static void reconcile_orphan_links(AppData *app, uint32_t *destroyed)
+{
+    FlatMapIter iter;
+    uint32_t key;
+    void *value;
+    uint32_t stale[64];
+    uint32_t n_stale = 0;
+
+    flatmap_iter_init(&iter, &app->links);
+    while (flatmap_iter_next(&iter, &key, &value) && n_stale < 64)
+    {
+        LinkInfo *li = value;
+        PortInfo *in_pi = flatmap_lookup(&app->ports, li->in_port_gid);
+        if (in_pi && in_pi->node_id == app->filter_node_id && in_pi->direction == 0 &&
+            find_stereo_slot(app, li->out_node_id) < 0)
+            stale[n_stale++] = key;
+    }
+
+    for (uint32_t i = 0; i < n_stale; i++)
+    {
+        /* An input no slot owns is free again once the link is gone; owned ones are set by reconcile_slot() */
+        LinkInfo *li = flatmap_lookup(&app->links, stale[i]);
+        if (li && li->filter_in_port_id >= 0 && !app->stereo_slots[li->filter_in_port_id / 2].occupied)
+        {
+            app->filter_in_occupied[li->filter_in_port_id] = false;
+            mark_slot_dirty(app, li->filter_in_port_id / 2);
+        }
+        printf("[reconcile] removing filter link id=%u from node without a slot\n", stale[i]);
+        reconcile_destroy(app, stale[i]);
+        (*destroyed)++;
+    }
+
+    /* Anything past the scan limit is picked up by the follow-up pass */
+    app->reconcile_orphans = n_stale == 64;
+}
+
+static void reconcile_links(AppData *app)
+{
+    ReconcileStats *st = &app->reconcile;
+    uint32_t created = 0, destroyed = 0, kept = 0;
+
+    st->passes++;
+
+    for (int slot = 0; slot < MAX_STEREO_SLOTS; slot++)
+    {
+        if (!app->stereo_slots[slot].occupied || !app->stereo_slots[slot].out_node_id)
+            continue;
+
+        bool was_connected = app->filter_in_occupied[slot * 2] || app->filter_in_occupied[slot * 2 + 1];
+        reconcile_slot(app, slot, &created, &destroyed, &kept);
+        bool connected = app->filter_in_occupied[slot * 2] || app->filter_in_occupied[slot * 2 + 1];
+        if (connected != was_connected)
+            mark_slot_dirty(app, slot);
+    }
+
+    if (app->reconcile_orphans && app->filter_node_id != 0)
+        reconcile_orphan_links(app, &destroyed);
+
+    /* A verification pass re-finds what the previous pass set up; do not count that as avoided */
+    if (!app->reconcile_verify)
+        st->kept += kept;
+    app->reconcile_verify = false;
+    st->created += created;
+    st->destroyed += destroyed;
+
+    if (created || destroyed)
+    {
+        printf("[reconcile] pass %llu: kept=%u created=%u destroyed=%u "
+               "(total: %llu requests in %llu passes, %llu links kept)\n",
+               (unsigned long long)st->passes, kept, created, destroyed,
+               (unsigned long long)st->requests, (unsigned long long)st->passes,
+               (unsigned long long)st->kept);
+
+        /* Verify the result once the server has applied it */
+        app->reconcile_verify = true;
+        reconcile_request(app);
+    }
+}
+
+/* Finishes slot setup for a source whose filter links were adopted or accepted */
+static void attach_slot_source(AppData *app, int slot, uint32_t node_id)
+{
+    app->sources[slot].source_node_id = node_id;
+
+    NodeInfo *ni = flatmap_lookup(&app->nodes, node_id);
+    set_source_label(app, slot, node_label(ni));
+    app->sources[slot].fixed_loudness = node_is_fixed_loudness(ni);
+    if (app->sources[slot].fixed_loudness)
+    {
+        printf("[source] slot %d fixed loudness enabled (node=%u app_name=%s)\n",
+               slot,
+               node_id,
+               (ni && ni->app_name) ? ni->app_name : "(unknown)");
+    }
+
+    mark_slot_dirty(app, slot);
+}
+
+/* Frees a slot; its filter links become orphans for the next reconcile pass */
+static void vacate_slot(AppData *app, int slot)
+{
+    if (!app->stereo_slots[slot].occupied)
+        return;
+
+    free_stereo_slot(app, app->stereo_slots[slot].out_node_id);
+    app->filter_in_occupied[slot * 2] = false;
+    app->filter_in_occupied[slot * 2 + 1] = false;
+    app->sources[slot].seed_from_filter = false;
+    app->reconcile_orphans = true;
+    mark_slot_dirty(app, slot);
+}
+
+/* Pins a playback stream to a slot (node_id 0 empties it); the reconciler relinks both */
+static void apply_slot_assignment(AppData *app, int slot, uint32_t node_id)
+{
+    if (slot < 0 || slot >= MAX_STEREO_SLOTS)
+        return;
+    if (app->stereo_slots[slot].occupied && app->stereo_slots[slot].out_node_id == node_id)
+        return;
+
+    if (node_id != 0)
+    {
+        NodeInfo *ni = flatmap_lookup(&app->nodes, node_id);
+        if (!ni || !ni->media_class || strcmp(ni->media_class, "Stream/Output/Audio") != 0)
+        {
+            printf("[slot] node %u is not a playback stream, slot %d unchanged\n", node_id, slot);
+            return;
+        }
+
+        /* A source moves rather than holding two slots */
+        int prev = find_stereo_slot(app, node_id);
+        if (prev >= 0)
+            vacate_slot(app, prev);
+    }
+
+    vacate_slot(app, slot);
+    if (node_id != 0)
+    {
+        app->stereo_slots[slot].occupied = true;
+        app->stereo_slots[slot].out_node_id = node_id;
+        printf("[slot] assigned node %u to slot %d\n", node_id, slot);
+        link_retry_reset_slot(app, slot);
+        attach_slot_source(app, slot, node_id);
+    }
+    reconcile_request(app);
+}
+
+/*
+ * Takes an adopted slot's position from what the filter node holds, so a
+ * warm start neither moves nor re-levels it. Speakers are stored relative
+ * to the head; the listener is level until a tracker reports, so they are
+ * taken as world positions. Returns false until the read-back has arrived.
+ */
+static bool seed_slot_from_filter(AppData *app, int slot)
+{
+    const ControlTable *table = &app->controls;
+    int spk = slot * 2;
+    float az_l, az_r, el, radius, gain;
+
+    if (!control_shadow_value(table, ctl_spk(spk, CTL_PARAM_AZIMUTH), &az_l) ||
+        !control_shadow_value(table, ctl_spk(spk + 1, CTL_PARAM_AZIMUTH), &az_r) ||
+        !control_shadow_value(table, ctl_spk(spk, CTL_PARAM_ELEVATION), &el) ||
+        !control_shadow_value(table, ctl_spk(spk, CTL_PARAM_RADIUS), &radius) ||
+        !control_shadow_value(table, ctl_gain(CTL_MIX_L, spk), &gain))
+        return false;
+
+    float left = mirror_azimuth(az_l);
+    float half = fmodf(mirror_azimuth(az_r) - left + 360.0f, 360.0f) * 0.5f;
+    if (half > 45.0f)
+        half = 45.0f;
+    float center = fmodf(left + half, 360.0f);
+
+    /* The gain follows the radius unless loudness is fixed; keep the one the node plays */
+    if (!app->sources[slot].fixed_loudness)
+        radius = CLAMP((1.0f - gain) * 100.0f, MIN_RADIUS_PCT, 100.0f);
+
+    g_mutex_lock(&app->positions_lock);
+    app->sources[slot].azimuth = center;
+    app->sources[slot].width = half * 2.0f;
+    app->sources[slot].elevation = el;
+    app->sources[slot].radius = radius;
+    g_mutex_unlock(&app->positions_lock);
+
+    printf("[startup] slot %d keeps az %.1f el %.1f width %.1f radius %.1f from the filter\n",
+           slot, center, el, half * 2.0f, radius);
+    ui_mailbox_set_position(&app->mailbox, slot, el, half * 2.0f);
+    ui_mailbox_queue_redraw(&app->mailbox);
+    return true;
+}
+
+static void seed_adopted_slots(AppData *app)
+{
+    for (int slot = 0; slot < MAX_SOURCES; slot++)
+    {
+        if (app->sources[slot].seed_from_filter && seed_slot_from_filter(app, slot))
+            app->sources[slot].seed_from_filter = false;
+    }
+}
+
+/* No usable read-back: the slot is placed like a newly connected stream */
+static void seed_give_up(AppData *app, const char *why)
+{
+    for (int slot = 0; slot < MAX_SOURCES; slot++)
+    {
+        if (!app->sources[slot].seed_from_filter)
+            continue;
+
+        app->sources[slot].seed_from_filter = false;
+        g_mutex_lock(&app->positions_lock);
+        app->sources[slot].azimuth = random_slot_azimuth(app, slot);
+        g_mutex_unlock(&app->positions_lock);
+        printf("[startup] slot %d: %s; using a new position\n", slot, why);
+        send_sofa_control(app, slot);
+        ui_mailbox_queue_redraw(&app->mailbox);
+    }
+}
+
+static void on_seed_timer(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    seed_give_up(data, "no Props read-back from the filter");
+}
+
+/*
+ * Warm start: rebuild stereo_slots, filter_in_occupied and the slot sources
+ * from the filter links that survived a controller restart. A link is
+ * adopted when it already sits on input slot*2+ch; everything else is left
+ * to the reconciler, which only removes what conflicts.
+ */
+static void adopt_existing_filter_links(AppData *app)
+{
+    FlatMapIter iter;
+    void *value;
+    uint32_t adopted = 0, misplaced = 0;
+
+    for (int i = 0; i < 8; i++)
+        app->filter_in_occupied[i] = false;
+    for (int i = 0; i < MAX_STEREO_SLOTS; i++)
+    {
+        app->stereo_slots[i].occupied = false;
+        app->stereo_slots[i].out_node_id = 0;
+    }
+
+    flatmap_iter_init(&iter, &app->links);
+    while (flatmap_iter_next(&iter, NULL, &value))
+    {
+        LinkInfo *li = value;
+        PortInfo *out_pi = flatmap_lookup(&app->ports, li->out_port_gid);
+        PortInfo *in_pi = flatmap_lookup(&app->ports, li->in_port_gid);
+
+        /* From an untracked node: holds its input until the orphan pass removes it */
+        if (li->out_node_id == 0 && li->filter_in_port_id >= 0)
+        {
+            app->filter_in_occupied[li->filter_in_port_id] = true;
+            app->reconcile_orphans = true;
+            continue;
+        }
+        if (!out_pi || !in_pi || in_pi->node_id != app->filter_node_id || in_pi->direction != 0)
+            continue;
+        if (in_pi->port_id < 0 || in_pi->port_id >= 8)
+            continue;
+
+        int input = in_pi->port_id;
+        int slot = input / 2;
+        StereoSlot *ss = &app->stereo_slots[slot];
+
+        li->filter_in_port_id = -1;
+        if (out_pi->port_id != input % 2 || app->filter_in_occupied[input] ||
+            (ss->occupied && ss->out_node_id != out_pi->node_id))
+        {
+            misplaced++;
+            continue;
+        }
+
+        ss->occupied = true;
+        ss->out_node_id = out_pi->node_id;
+        li->filter_in_port_id = input;
+        app->filter_in_occupied[input] = true;
+        adopted++;
+    }
+
+    /* Adopted slots keep playing where they are; the rest start muted */
+    struct param_batch mute;
+    param_batch_init(&mute, app);
+    for (int slot = 0; slot < MAX_STEREO_SLOTS; slot++)
+    {
+        if (!app->stereo_slots[slot].occupied)
+        {
+            add_slot_gain(&mute, slot, 0.0f);
+            continue;
+        }
+        printf("[startup] adopted slot %d for node %u\n", slot, app->stereo_slots[slot].out_node_id);
+        app->sources[slot].initial_position_set = true;
+        app->sources[slot].seed_from_filter = true;
+        attach_slot_source(app, slot, app->stereo_slots[slot].out_node_id);
+    }
+    param_batch_commit(app, &mute);
+    seed_adopted_slots(app);
+    if (app->seed_timer)
+    {
+        struct timespec value = {SEED_TIMEOUT_USEC / G_USEC_PER_SEC, (SEED_TIMEOUT_USEC % G_USEC_PER_SEC) * 1000};
+        pw_loop_update_timer(pw_main_loop_get_loop(app->loop), app->seed_timer, &value, NULL, false);
+    }
+
+    /* Sources that only have misplaced links get a free slot; the reconciler moves their links */
+    if (misplaced)
+    {
+        flatmap_iter_init(&iter, &app->links);
+        while (flatmap_iter_next(&iter, NULL, &value))
+        {
+            LinkInfo *li = value;
+            PortInfo *in_pi = flatmap_lookup(&app->ports, li->in_port_gid);
+
+            if (li->filter_in_port_id >= 0 || !in_pi || li->out_node_id == 0 ||
+                in_pi->node_id != app->filter_node_id || in_pi->direction != 0)
+                continue;
+            if (find_stereo_slot(app, li->out_node_id) >= 0)
+                continue;
+
+            int slot = find_or_allocate_stereo_slot(app, li->out_node_id);
+            if (slot >= 0)
+                app->sources[slot].source_node_id = li->out_node_id;
+        }
+        app->reconcile_orphans = true;
+    }
+
+    printf("[startup] adopted %u existing filter links, %u left to the reconciler\n",
+           adopted, misplaced);
+
+    reconcile_request(app);
+}
+
+struct param_item
+{
+    uint32_t ctl;   /* index into AppData.controls */
+    float value;
+};
+
+/* Collects control updates for one or more sources so they reach the
+ * filter node as a single SPA_PROP_params struct and one pw_node_set_param. */
+struct param_batch
+{
+    AppData *app;
+    struct pw_proxy *proxy;
+    ControlTable *table;
+    const SofaGrid *grid;   /* set in SOFA_RESOLUTION_GRID mode */
+    uint64_t seen;  /* bit per control already in items */
+    uint32_t n_items;
+    struct param_item items[CTL_COUNT];
+};
+
+static void param_batch_init(struct param_batch *batch, AppData *data)
+{
+    batch->app = data;
+    batch->proxy = data->filter_proxy;
+    batch->table = &data->controls;
+    batch->grid = (data->sofa_resolution == SOFA_RESOLUTION_GRID && sofa_grid_loaded(&data->sofa_grid))
+                      ? &data->sofa_grid
+                      : NULL;
+    batch->seen = 0;
+    batch->n_items = 0;
+}
+
+static void param_batch_add(struct param_batch *batch, uint32_t ctl, float value)
+{
+    if (ctl >= CTL_COUNT)
+        return;
+
+    /* A later value for the same control replaces the earlier one */
+    if (batch->seen & (UINT64_C(1) << ctl))
+    {
+        for (uint32_t i = 0; i < batch->n_items; i++)
+        {
+            if (batch->items[i].ctl == ctl)
+            {
+                batch->items[i].value = value;
+                return;
+            }
+        }
+    }
+
+    batch->seen |= UINT64_C(1) << ctl;
+    batch->items[batch->n_items].ctl = ctl;
+    batch->items[batch->n_items].value = value;
+    batch->n_items++;
+}
+
+/* Bit per speaker whose new azimuth/elevation still selects the HRIR the node already uses */
+static uint32_t speakers_in_same_cell(const struct param_batch *batch)
+{
+    float az[CTL_SPK_COUNT], el[CTL_SPK_COUNT];
+    float ref_az[CTL_SPK_COUNT] = {0}, ref_el[CTL_SPK_COUNT] = {0};
+    bool known[CTL_SPK_COUNT];
+    uint32_t moved = 0, same = 0;
+
+    for (int spk = 0; spk < CTL_SPK_COUNT; spk++)
+    {
+        known[spk] = control_shadow_value(batch->table, ctl_spk(spk, CTL_PARAM_AZIMUTH), &ref_az[spk]) &&
+                     control_shadow_value(batch->table, ctl_spk(spk, CTL_PARAM_ELEVATION), &ref_el[spk]);
+        az[spk] = ref_az[spk];
+        el[spk] = ref_el[spk];
+    }
+
+    for (uint32_t i = 0; i < batch->n_items; i++)
+    {
+        uint32_t ctl = batch->items[i].ctl;
+        if (ctl >= CTL_GAIN_BASE)
+            continue;
+
+        int spk = ctl / CTL_PARAMS_PER_SPK;
+        if (ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_AZIMUTH)
+            az[spk] = batch->items[i].value;
+        else if (ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_ELEVATION)
+            el[spk] = batch->items[i].value;
+        else
+            continue;
+        moved |= 1u << spk;
+    }
+
+    for (int spk = 0; spk < CTL_SPK_COUNT; spk++)
+    {
+        if (!(moved & (1u << spk)) || !known[spk])
+            continue;
+        if (sofa_grid_nearest(batch->grid, az[spk], el[spk]) ==
+            sofa_grid_nearest(batch->grid, ref_az[spk], ref_el[spk]))
+            same |= 1u << spk;
+    }
+    return same;
+}
+
+/*
+ * The node answers Props updates in order: once a core sync issued after
+ * an update is done, the reports that arrived since reflect it. One sync
+ * is in flight at a time; its done issues the next if more were sent.
+ */
+static void props_sync_request(AppData *app)
+{
+    if (app->props_sync_seq != 0 || !app->core)
+        return;
+
+    int seq = pw_core_sync(app->core, PW_ID_CORE, 0);
+    if (seq > 0)
+    {
+        app->props_sync_seq = seq;
+        app->props_sync_gen = app->controls.send_gen;
+    }
+}
+
+/* Builds the Props update and sends it; returns the number of controls that went out */
+static uint32_t param_batch_emit(const struct param_batch *batch)
+{
+    if (!batch->proxy || batch->n_items == 0)
+        return 0;
+
+    uint8_t buffer[CTL_COUNT * sizeof(((FilterControl *)0)->pod) + 64];
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+    struct spa_pod_frame f, f_struct;
+    uint32_t n_sent = 0;
+    uint32_t same_cell = batch->grid ? speakers_in_same_cell(batch) : 0;
+
+    spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+    spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+    spa_pod_builder_push_struct(&b, &f_struct);
+    for (uint32_t i = 0; i < batch->n_items; i++)
+    {
+        uint32_t ctl = batch->items[i].ctl;
+        float value = batch->items[i].value;
+
+        /* Only controls that differ from what the node holds go out */
+        if (!control_shadow_needs(batch->table, ctl, value))
+            continue;
+
+        /* Position moves inside one measurement cell would reload the same HRIR */
+        if (ctl < CTL_GAIN_BASE && (same_cell & (1u << (ctl / CTL_PARAMS_PER_SPK))) &&
+            (ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_AZIMUTH || ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_ELEVATION))
+            continue;
+
+        /* Name and float are pre-serialized; only the payload is patched */
+        const FilterControl *c = control_table_patch(batch->table, ctl, value);
+        if (c)
+        {
+            spa_pod_builder_raw(&b, c->pod, c->size);
+            control_shadow_sent(batch->table, ctl, value);
+            n_sent++;
+        }
+    }
+    spa_pod_builder_pop(&b, &f_struct);
+    spa_pod_builder_pop(&b, &f);
+
+    if (n_sent == 0)
+        return 0;
+
+    struct spa_pod *pod = spa_pod_builder_deref(&b, 0);
+    pw_node_set_param((struct pw_node *)batch->proxy, SPA_PARAM_Props, 0, pod);
+    control_shadow_commit(batch->table);
+    if (batch->app)
+        props_sync_request(batch->app);
+    if (batch->app && !batch->app->props_sent_usec)
+        batch->app->props_sent_usec = g_get_monotonic_time();
+    return n_sent;
+}
+
+/*
+ * Cycle alignment. filter-chain writes control values from its main thread
+ * while the graph may be mid-cycle, so a group sent late in a cycle can be
+ * split across the boundary. The clock probe stamps every cycle; groups wait
+ * for the next stamp and leave right after it, with most of a quantum to land.
+ */
+#ifndef PW_KEY_NODE_DRIVER_ID
+#define PW_KEY_NODE_DRIVER_ID "node.driver-id"
+#endif
+
+#define CYCLE_SAFE_PHASE    0.5   /* fraction of a cycle after which a send may cross the boundary */
+#define ALIGN_REPORT_EVERY  100   /* groups between straddle reports */
+
+static uint64_t monotonic_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * SPA_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* Data thread: stamp the cycle and wake the pw thread if a group is waiting for one */
+static void on_clock_probe_process(void *data, struct spa_io_position *position)
+{
+    AppData *app = data;
+
+    if (position)
+    {
+        __atomic_store_n(&app->cycle_nsec, position->clock.nsec, __ATOMIC_RELAXED);
+        __atomic_store_n(&app->cycle_next_nsec, position->clock.next_nsec, __ATOMIC_RELAXED);
+        __atomic_store_n(&app->cycle_clock_id, position->clock.id, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&app->cycle_count, 1, __ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n(&app->cycle_wanted, 0, __ATOMIC_ACQ_REL))
+        pw_loop_signal_event(pw_main_loop_get_loop(app->loop), app->cycle_event);
+}
+
+/*
+ * Cycle stamps only mean something for the filter when the probe runs on the
+ * filter's driver. The probe joins the filter's node.group for that; while
+ * the filter reports a different driver than the stamped cycles, groups go
+ * out unaligned.
+ */
+static bool clock_probe_on_filter_driver(AppData *app)
+{
+    if (!app->clock_probe_streaming)
+        return false;
+    if (app->filter_driver_id != 0)
+        return __atomic_load_n(&app->cycle_clock_id, __ATOMIC_RELAXED) == app->filter_driver_id;
+    return app->filter_group[0] != '\0';
+}
+
+/* Counts a sent group as straddling when it left past the safe phase of its cycle */
+static void note_group_sent(AppData *app)
+{
+    if (!clock_probe_on_filter_driver(app))
+        return;
+
+    uint64_t count, nsec, next_nsec;
+    do
+    {
+        count = __atomic_load_n(&app->cycle_count, __ATOMIC_ACQUIRE);
+        nsec = __atomic_load_n(&app->cycle_nsec, __ATOMIC_RELAXED);
+        next_nsec = __atomic_load_n(&app->cycle_next_nsec, __ATOMIC_RELAXED);
+    } while (__atomic_load_n(&app->cycle_count, __ATOMIC_ACQUIRE) != count);
+
+    if (next_nsec <= nsec)
+        return;
+
+    double phase = (double)(monotonic_nsec() - nsec) / (double)(next_nsec - nsec);
+    app->groups_sent++;
+    if (phase > CYCLE_SAFE_PHASE)
+        app->groups_straddled++;
+
+    if (app->groups_sent % ALIGN_REPORT_EVERY == 0)
+        printf("[align] %llu groups sent, %llu (%.1f%%) may have straddled a cycle boundary\n",
+               (unsigned long long)app->groups_sent, (unsigned long long)app->groups_straddled,
+               100.0 * (double)app->groups_straddled / (double)app->groups_sent);
+}
+
+/* Sends everything collected for the coming cycle as one Props update */
+static void group_flush(AppData *app)
+{
+    uint64_t mask = app->group_mask;
+    app->group_mask = 0;
+    if (!mask)
+        return;
+
+    struct param_batch batch;
+    param_batch_init(&batch, app);
+    for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++)
+    {
+        if (mask & (UINT64_C(1) << ctl))
+            param_batch_add(&batch, ctl, app->group_values[ctl]);
+    }
+    if (param_batch_emit(&batch) > 0)
+        note_group_sent(app);
+}
+
+static void on_cycle_event(void *data, uint64_t count)
+{
+    (void)count;
+    group_flush(data);
+}
+
+static void on_clock_probe_state(void *data, enum pw_filter_state old,
+                                 enum pw_filter_state state, const char *error)
+{
+    (void)old;
+    AppData *app = data;
+    bool streaming = state == PW_FILTER_STATE_STREAMING;
+
+    if (streaming == app->clock_probe_streaming)
+        return;
+
+    app->clock_probe_streaming = streaming;
+    printf("[align] clock probe %s%s%s\n", pw_filter_state_as_string(state),
+           error ? ": " : "", error ? error : "");
+
+    /* Without cycle stamps a waiting group would never be woken */
+    if (!streaming)
+    {
+        __atomic_store_n(&app->cycle_wanted, 0, __ATOMIC_RELEASE);
+        group_flush(app);
+    }
+}
+
+static const struct pw_filter_events clock_probe_events = {
+    PW_VERSION_FILTER_EVENTS,
+    .state_changed = on_clock_probe_state,
+    .process = on_clock_probe_process,
+};
+
+/*
+ * The probe is scheduled every quantum, so it is only active while a stream
+ * feeds the filter. The graph runs then anyway; an active probe on an idle
+ * graph would keep the driver from suspending. Inactive, groups go out
+ * unaligned.
+ */
+static void clock_probe_update(AppData *app)
+{
+    if (!app->clock_probe)
+        return;
+
+    bool want = false;
+    for (int i = 0; i < 8; i++)
+        want |= app->filter_in_occupied[i];
+
+    if (want == app->clock_probe_active)
+        return;
+    app->clock_probe_active = want;
+    pw_filter_set_active(app->clock_probe, want);
+}
+
+/* A port-less node that is always scheduled, so its process callback sees every driver cycle */
+static void clock_probe_start(AppData *app)
+{
+    app->cycle_event = pw_loop_add_event(pw_main_loop_get_loop(app->loop), on_cycle_event, app);
+    if (!app->cycle_event)
+        return;
+
+    struct pw_properties *props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio",
+                                                    PW_KEY_MEDIA_CATEGORY, "Filter",
+                                                    PW_KEY_NODE_ALWAYS_PROCESS, "true",
+                                                    NULL);
+    if (props && app->filter_group[0])
+        pw_properties_set(props, PW_KEY_NODE_GROUP, app->filter_group);
+    app->clock_probe = pw_filter_new(app->core, "pw-3d-mixer-clock", props);
+    if (!app->clock_probe)
+    {
+        fprintf(stderr, "[align] could not create clock probe; sending groups unaligned\n");
+        return;
+    }
+
+    pw_filter_add_listener(app->clock_probe, &app->clock_probe_listener, &clock_probe_events, app);
+    if (pw_filter_connect(app->clock_probe, PW_FILTER_FLAG_RT_PROCESS | PW_FILTER_FLAG_INACTIVE,
+                          NULL, 0) < 0)
+    {
+        fprintf(stderr, "[align] could not connect clock probe; sending groups unaligned\n");
+        spa_hook_remove(&app->clock_probe_listener);
+        pw_filter_destroy(app->clock_probe);
+        app->clock_probe = NULL;
+    }
+}
+
+/* Puts the probe in the filter's node.group so both are scheduled by the same driver */
+static void clock_probe_join_group(AppData *app, const char *group)
+{
+    if (!group)
+        group = "";
+    if (strcmp(group, app->filter_group) == 0)
+        return;
+
+    g_strlcpy(app->filter_group, group, sizeof(app->filter_group));
+    if (!app->clock_probe)
+        return;
+
+    struct spa_dict_item items[] = {SPA_DICT_ITEM_INIT(PW_KEY_NODE_GROUP, group)};
+    pw_filter_update_properties(app->clock_probe, NULL, &SPA_DICT_INIT_ARRAY(items));
+    printf("[align] clock probe joins node.group \"%s\"\n", group);
+}
+
+/* Sends the batch now, or merges it into the group that leaves after the next cycle starts */
+static void param_batch_send(const struct param_batch *batch)
+{
+    AppData *app = batch->app;
+
+    if (!batch->proxy || batch->n_items == 0)
+        return;
+
+    if (app->align_groups && clock_probe_on_filter_driver(app))
+    {
+        for (uint32_t i = 0; i < batch->n_items; i++)
+        {
+            app->group_values[batch->items[i].ctl] = batch->items[i].value;
+            app->group_mask |= UINT64_C(1) << batch->items[i].ctl;
+        }
+        __atomic_store_n(&app->cycle_wanted, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    if (param_batch_emit(batch) > 0)
+        note_group_sent(app);
+}
+
+/* Props update that carries everything handed to the control path so far */
+uint32_t controls_handoff_gen(AppData *app)
+{
+    /* A queued group or a running ramp sends its next values in a later update */
+    if (app->group_mask || app->ramps.active)
+        return app->controls.send_gen + 1;
+    return app->controls.send_gen;
+}
+
+static bool pod_get_number(const struct spa_pod *pod, float *value)
+{
+    double d;
+    int32_t i;
+    bool b;
+
+    if (spa_pod_get_float(pod, value) >= 0)
+        return true;
+    if (spa_pod_get_double(pod, &d) >= 0)
+    {
+        *value = (float)d;
+        return true;
+    }
+    if (spa_pod_get_int(pod, &i) >= 0)
+    {
+        *value = (float)i;
+        return true;
+    }
+    if (spa_pod_get_bool(pod, &b) >= 0)
+    {
+        *value = b ? 1.0f : 0.0f;
+        return true;
+    }
+    return false;
+}
+
+#define APPLY_USEC_WEIGHT 0.125   /* weight of a new send -> read-back time in the running mean */
+#define CLOCK_QUANTUM_DEFAULT 1024
+#define CLOCK_RATE_DEFAULT 48000
+
+/* Graph quantum and rate from the settings metadata, forced values first */
+static void graph_clock(const AppData *app, uint32_t *quantum, uint32_t *rate)
+{
+    *quantum = app->clock_force_quantum ? app->clock_force_quantum
+             : app->clock_quantum       ? app->clock_quantum
+                                        : CLOCK_QUANTUM_DEFAULT;
+    *rate = app->clock_force_rate ? app->clock_force_rate
+          : app->clock_rate       ? app->clock_rate
+                                  : CLOCK_RATE_DEFAULT;
+}
+
+/* Filter output latency: everything between the filter's output and the speakers */
+static void on_filter_latency(AppData *app, const struct spa_pod *param)
+{
+    struct spa_latency_info info;
+    uint32_t quantum, rate;
+
+    if (!param || spa_latency_parse(param, &info) < 0 || info.direction != SPA_DIRECTION_OUTPUT)
+        return;
+
+    graph_clock(app, &quantum, &rate);
+    double usec = (double)info.max_quantum * quantum * 1e6 / rate +
+                  (double)info.max_rate * 1e6 / rate + (double)info.max_ns / 1000.0;
+    uint32_t latency = usec > 0.0 ? (uint32_t)usec : 0;
+    if (latency == app->node_latency_usec)
+        return;
+
+    app->node_latency_usec = latency;
+    printf("[predict] filter output latency %u us\n", latency);
+}
+
+/* Props read-back: the params struct is a flat list of name, value pairs */
+static void on_filter_param(void *data, int seq, uint32_t id, uint32_t index,
+                            uint32_t next, const struct spa_pod *param)
+{
+    AppData *app = data;
+
+    if (id == SPA_PARAM_Latency)
+    {
+        on_filter_latency(app, param);
+        return;
+    }
+    if (id != SPA_PARAM_Props || !param || !spa_pod_is_object_type(param, SPA_TYPE_OBJECT_Props))
+        return;
+
+    const struct spa_pod_object *obj = (const struct spa_pod_object *)param;
+    const struct spa_pod_prop *prop;
+    uint32_t n_reported = 0;
+
+    SPA_POD_OBJECT_FOREACH(obj, prop)
+    {
+        if (prop->key != SPA_PROP_params || !spa_pod_is_struct(&prop->value))
+            continue;
+
+        const struct spa_pod *item;
+        const char *name = NULL;
+        SPA_POD_STRUCT_FOREACH(&prop->value, item)
+        {
+            if (!name)
+            {
+                if (spa_pod_get_string(item, &name) < 0)
+                    name = NULL;
+                continue;
+            }
+
+            float value;
+            int ctl = control_table_find(&app->controls, name);
+            if (ctl >= 0 && pod_get_number(item, &value))
+            {
+                control_shadow_report(&app->controls, (uint32_t)ctl, value);
+                n_reported++;
+            }
+            name = NULL;
+        }
+    }
+
+    /* The read-back follows the node applying our update: time the round trip */
+    if (n_reported > 0 && app->props_sent_usec)
+    {
+        double rtt = (double)(g_get_monotonic_time() - app->props_sent_usec);
+        app->apply_usec = app->apply_usec
+            ? (uint32_t)(app->apply_usec + APPLY_USEC_WEIGHT * (rtt - app->apply_usec))
+            : (uint32_t)rtt;
+        app->props_sent_usec = 0;
+    }
+
+    if (n_reported == 0)
+        return;
+
+    seed_adopted_slots(app);
+    if (!app->controls_synced)
+    {
+        app->controls_synced = true;
+        printf("[controls] read back %u controls from the filter node\n", n_reported);
+        /* The first read-back lists every control; a slot still unseeded will not get its values */
+        seed_give_up(app, "Props read-back lacks its controls");
+    }
+}
+
+/* The filter's group and driver decide whether the probe's cycles are the filter's */
+static void on_filter_info(void *data, const struct pw_node_info *info)
+{
+    AppData *app = data;
+
+    if (!info || !(info->change_mask & PW_NODE_CHANGE_MASK_PROPS) || !info->props)
+        return;
+
+    const char *driver_id = spa_dict_lookup(info->props, PW_KEY_NODE_DRIVER_ID);
+    uint32_t driver = driver_id ? (uint32_t)strtoul(driver_id, NULL, 10) : 0;
+    if (driver != app->filter_driver_id)
+    {
+        app->filter_driver_id = driver;
+        printf("[align] filter driver is node %u\n", driver);
+    }
+    clock_probe_join_group(app, spa_dict_lookup(info->props, PW_KEY_NODE_GROUP));
+}
+
+static const struct pw_node_events filter_node_events = {
+    PW_VERSION_NODE_EVENTS,
+    .info = on_filter_info,
+    .param = on_filter_param,
+};
+
+/*
+ * Hands the batch to the PipeWire thread as one unit. Callers on the
+ * PipeWire thread apply it in place, after anything the GTK thread posted
+ * earlier, so the latest-value cells keep a single writer.
+ */
+static void param_batch_commit(AppData *data, const struct param_batch *batch)
+{
+    if (!batch->proxy || batch->n_items == 0 || !data->command_event)
+        return;
+
+    if (g_thread_self() == data->pw_thread)
+    {
+        float values[CTL_COUNT];
+        uint64_t mask = 0;
+
+        take_posted_controls(data);
+        for (uint32_t i = 0; i < batch->n_items; i++)
+        {
+            values[batch->items[i].ctl] = batch->items[i].value;
+            mask |= UINT64_C(1) << batch->items[i].ctl;
+        }
+        apply_control_values(data, values, mask);
+        return;
+    }
+
+    command_ring_begin_controls(&data->commands);
+    for (uint32_t i = 0; i < batch->n_items; i++)
+    {
+        command_ring_set_control(&data->commands, batch->items[i].ctl, batch->items[i].value);
+    }
+    command_ring_end_controls(&data->commands);
+    pw_loop_signal_event(pw_main_loop_get_loop(data->loop), data->command_event);
+}
+
+static void add_slot_gain(struct param_batch *batch, int slot, float gain)
+{
+    int base_channel = slot * 2;
+
+    for (int i = 0; i < 2; i++)
+    {
+        param_batch_add(batch, ctl_gain(CTL_MIX_L, base_channel + i), gain);
+        param_batch_add(batch, ctl_gain(CTL_MIX_R, base_channel + i), gain);
+    }
+}
+
+static void set_slot_gain(AppData *data, int slot, float gain)
+{
+    if (!data || !data->filter_proxy)
+        return;
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    struct param_batch batch;
+    param_batch_init(&batch, data);
+    add_slot_gain(&batch, slot, gain);
+    param_batch_commit(data, &batch);
+}
+
+/* Appends every changed SOFA and mixer control of one source to the batch */
+static void collect_sofa_controls(AppData *data, int source_idx, const ListenerRotation *listener,
+                                  struct param_batch *batch)
+{
+    if (!data->sources[source_idx].active || !data->filter_proxy)
+        return;
+
+    if (source_idx < 0 || source_idx >= 4)
+        return;
+
+    if (data->sources[source_idx].bypass)
+    {
+        /* When bypassing, skip parameter updates */
+        return;
+    }
+
+    /* An adopted slot's position is unknown until the read-back seeds it; sending would move it */
+    if (data->sources[source_idx].seed_from_filter)
+        return;
+
+    /* Runs on either thread; positions are read as one consistent set */
+    g_mutex_lock(&data->positions_lock);
+    float center = data->sources[source_idx].azimuth;
+    float width = data->sources[source_idx].width;
+    float elevation = data->sources[source_idx].elevation;
+    float radius = data->sources[source_idx].radius;
+    g_mutex_unlock(&data->positions_lock);
+    float gain = data->sources[source_idx].fixed_loudness ? 1.0f : radius_to_gain(radius);
+
+    float half = width * 0.5f;
+
+    float left_az = center - half;
+    float right_az = center + half;
+
+    if (left_az < 0.0f)
+        left_az += 360.0f;
+    if (left_az >= 360.0f)
+        left_az -= 360.0f;
+    if (right_az < 0.0f)
+        right_az += 360.0f;
+    if (right_az >= 360.0f)
+        right_az -= 360.0f;
+
+    const float azimuths[] = {left_az, right_az};
+    float bypass = data->sources[source_idx].bypass ? 1.0f : 0.0f;
+    /* Every control is offered; param_batch_emit() drops the ones the node already holds,
+     * after the ramp and cycle-group stages have seen them */
+    for (int i = 0; i < 2; i++)
+    {
+        int spk = source_idx * 2 + i; /* spk1/spk2 for source 0, ... */
+        float head_az, head_el;
+
+        /* Speakers stay put in the world; the filter gets them relative to the listener's head */
+        listener_rotation_apply(listener, azimuths[i], elevation, &head_az, &head_el);
+        param_batch_add(batch, ctl_spk(spk, CTL_PARAM_AZIMUTH), mirror_azimuth(head_az));
+        param_batch_add(batch, ctl_spk(spk, CTL_PARAM_ELEVATION), head_el);
+        param_batch_add(batch, ctl_spk(spk, CTL_PARAM_RADIUS), radius);
+        param_batch_add(batch, ctl_spk(spk, CTL_PARAM_BYPASS), bypass);
+    }
+
+    add_slot_gain(batch, source_idx, gain);
+}
+
+static void listener_snapshot(AppData *data, ListenerRotation *listener)
+{
+    g_mutex_lock(&data->listener_lock);
+    *listener = data->listener;
+    g_mutex_unlock(&data->listener_lock);
+}
+
+void send_sofa_control(AppData *data, int source_idx)
+{
+    if (source_idx < 0 || source_idx >= MAX_SOURCES)
+        return;
+    send_sofa_controls(data, 1u << source_idx);
+}
+
+/* Sends every source in source_mask (bit per source) as one batch */
+void send_sofa_controls(AppData *data, guint source_mask)
+{
+    struct param_batch batch;
+    ListenerRotation listener;
+
+    if (!source_mask)
+        return;
+
+    listener_snapshot(data, &listener);
+    param_batch_init(&batch, data);
+    for (int i = 0; i < MAX_SOURCES; i++)
+    {
+        if (source_mask & (1u << i))
+            collect_sofa_controls(data, i, &listener, &batch);
+    }
+    param_batch_commit(data, &batch);
+}
+
+/* A head turn moves every source at once: all active slots go out as one batch (pw thread) */
+void set_listener_orientation(AppData *data, float yaw, float pitch, float roll)
+{
+    g_mutex_lock(&data->listener_lock);
+    bool changed = yaw != data->listener_yaw || pitch != data->listener_pitch || roll != data->listener_roll;
+    if (changed)
+    {
+        data->listener_yaw = yaw;
+        data->listener_pitch = pitch;
+        data->listener_roll = roll;
+        listener_rotation_set(&data->listener, yaw, pitch, roll);
+    }
+    g_mutex_unlock(&data->listener_lock);
+
+    if (!changed)
+        return;
+
+    /* Readers see the applied pose right away rather than on the next tick */
+    if (data->shm_state)
+        shm_state_publish(data->shm_state);
+
+    guint mask = 0;
+    for (int i = 0; i < MAX_SOURCES; i++)
+    {
+        if (data->sources[i].active && !data->sources[i].bypass)
+            mask |= 1u << i;
+    }
+    send_sofa_controls(data, mask);
+}
+
+#define PREDICT_REPORT_EVERY 300   /* scored predictions between error reports */
+
+/*
+ * Motion-to-sound latency: from a control send until the filter plays it.
+ * A control ramp retargeted on every tick trails its target by its whole
+ * length, the Props round trip bounds when the node has the values, the
+ * cycle that picks them up adds a quantum (half of one more while waiting
+ * for a cycle start), and the filter's output Latency param covers the
+ * rest to the device.
+ */
+static uint32_t motion_to_sound_usec(const AppData *data)
+{
+    uint32_t quantum, rate;
+    graph_clock(data, &quantum, &rate);
+    uint64_t quantum_usec = (uint64_t)quantum * 1000000 / rate;
+
+    uint64_t usec = data->apply_usec + quantum_usec + data->node_latency_usec;
+    uint32_t tick = data->ramp_tick_usec;
+    if (data->ramps.ramp_usec && tick)
+        usec += (uint64_t)((data->ramps.ramp_usec + tick - 1) / tick) * tick;
+    if (data->align_groups)
+        usec += quantum_usec / 2;
+    return (uint32_t)usec;
+}
+
+static void report_prediction(AppData *data)
+{
+    ListenerErrors *e = &data->predictor.errors;
+    if (e->n < PREDICT_REPORT_EVERY)
+        return;
+
+    printf("[predict] %u predictions, %.1f ms ahead (motion-to-sound %.1f ms): error rms %.2f max %.2f deg, "
+           "unpredicted rms %.2f max %.2f deg%s\n",
+           e->n, (double)e->span_usec / e->n / 1000.0, motion_to_sound_usec(data) / 1000.0,
+           sqrt(e->sq_predicted / e->n), e->max_predicted, sqrt(e->sq_held / e->n), e->max_held,
+           data->predict_listener ? "" : " (prediction off)");
+    memset(e, 0, sizeof(*e));
+}
+
+/* A tracked head pose, sampled at sample_usec on the monotonic clock (pw thread only) */
+void track_listener_orientation(AppData *data, float yaw, float pitch, float roll, gint64 sample_usec)
+{
+    const float ypr[3] = {yaw, pitch, roll};
+    listener_predictor_sample(&data->predictor, ypr, (uint64_t)sample_usec);
+    report_prediction(data);
+}
+
+/*
+ * Sends the tracked pose as it should be by the time this send is heard.
+ * Without a fresh sample since the last call the prediction carries on;
+ * once the tracker has been silent for a few of its sample intervals the
+ * newest pose is taken to be holding. Returns true while the sent pose is
+ * still extrapolated; callers then call again on their next tick so it
+ * settles onto the last pose reported.
+ */
+bool apply_tracked_orientation(AppData *data, bool fresh)
+{
+    ListenerPredictor *p = &data->predictor;
+    gint64 now = g_get_monotonic_time();
+    float ypr[3];
+
+    if (!fresh)
+        listener_predictor_hold(p, (uint64_t)now);
+
+    /* Predicted either way so the error report shows what prediction would do */
+    bool moving = listener_predictor_predict(p, (uint64_t)now + motion_to_sound_usec(data), ypr);
+    if (!data->predict_listener)
+    {
+        memcpy(ypr, p->last_sample, sizeof(ypr));
+        moving = false;
+    }
+    set_listener_orientation(data, ypr[0], ypr[1], ypr[2]);
+    return moving;
+}
+
+#define RAMP_MS_DEFAULT 60
+#define RAMP_TICK_MIN_USEC 5000
+
+static void ramp_timer_set(AppData *app, uint32_t usec)
+{
+    struct timespec value = {usec / 1000000, (long)(usec % 1000000) * 1000};
+    pw_loop_update_timer(pw_main_loop_get_loop(app->loop), app->ramp_timer, &value, &value, false);
+}
+
+static void ramp_timer_arm(AppData *app)
+{
+    if (app->ramp_timer_armed || !app->ramp_timer)
+        return;
+    ramp_timer_set(app, app->ramp_tick_usec);
+    app->ramp_timer_armed = true;
+}
+
+static void ramp_timer_disarm(AppData *app)
+{
+    if (!app->ramp_timer_armed)
+        return;
+    ramp_timer_set(app, 0);
+    app->ramp_timer_armed = false;
+}
+
+/* The control tick is a whole number of graph quanta, at least RAMP_TICK_MIN_USEC long */
+static void update_ramp_tick(AppData *app)
+{
+    uint32_t quantum, rate;
+    graph_clock(app, &quantum, &rate);
+    uint64_t quantum_usec = (uint64_t)quantum * 1000000 / rate;
+    if (quantum_usec == 0)
+        quantum_usec = 1;
+
+    uint64_t quanta = (RAMP_TICK_MIN_USEC + quantum_usec - 1) / quantum_usec;
+    uint32_t tick = (uint32_t)(quanta * quantum_usec);
+    if (tick == app->ramp_tick_usec)
+        return;
+
+    app->ramp_tick_usec = tick;
+    printf("[ramp] control tick %u us (%llu x quantum %u @ %u Hz)\n",
+           tick, (unsigned long long)quanta, quantum, rate);
+
+    if (app->ramp_timer_armed)
+        ramp_timer_set(app, tick);
+}
+
+static void on_ramp_timer(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    AppData *app = data;
+    float values[CTL_COUNT];
+
+    uint64_t mask = ramp_engine_tick(&app->ramps, values);
+    if (mask)
+    {
+        struct param_batch batch;
+        param_batch_init(&batch, app);
+        for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++)
+        {
+            if (mask & (UINT64_C(1) << ctl))
+                param_batch_add(&batch, ctl, values[ctl]);
+        }
+        param_batch_send(&batch);
+    }
+
+    if (!app->ramps.active)
+        ramp_timer_disarm(app);
+}
+
+static int on_settings_property(void *data, uint32_t subject, const char *key,
+                                const char *type, const char *value)
+{
+    AppData *app = data;
+    uint32_t v = value ? (uint32_t)strtoul(value, NULL, 10) : 0;
+
+    if (subject != PW_ID_CORE)
+        return 0;
+
+    if (!key)
+    {
+        app->clock_quantum = app->clock_rate = 0;
+        app->clock_force_quantum = app->clock_force_rate = 0;
+    }
+    else if (strcmp(key, "clock.quantum") == 0)
+        app->clock_quantum = v;
+    else if (strcmp(key, "clock.rate") == 0)
+        app->clock_rate = v;
+    else if (strcmp(key, "clock.force-quantum") == 0)
+        app->clock_force_quantum = v;
+    else if (strcmp(key, "clock.force-rate") == 0)
+        app->clock_force_rate = v;
+    else
+        return 0;
 
-    gint64 now = g_get_monotonic_time();
-    if (data->sources[source_idx].last_sofa_usec != 0 &&
-        now - data->sources[source_idx].last_sofa_usec < 40000)
-    { /* 40ms throttle */
+    update_ramp_tick(app);
+    return 0;
+}
+
+static const struct pw_metadata_events settings_events = {
+    PW_VERSION_METADATA_EVENTS,
+    .property = on_settings_property,
+};
+
+static void run_command(AppData *app, const Command *cmd)
+{
+    switch (cmd->type)
+    {
+    case CMD_SET_BYPASS:
+        apply_source_bypass(app, cmd->source_idx, cmd->flag != 0);
+        break;
+    case CMD_RELINK:
+        apply_source_bypass(app, cmd->source_idx, false);
+        break;
+    case CMD_CLEANUP_LINKS:
+        cleanup_existing_filter_links(app);
+        break;
+    case CMD_ASSIGN_SLOT:
+        apply_slot_assignment(app, cmd->source_idx, cmd->flag);
+        break;
+    default:
+        break;
+    }
+}
+
+/* New values become ramp targets; only unramped ones go out now, as one Props update */
+static void apply_control_values(AppData *app, const float values[CTL_COUNT], uint64_t mask)
+{
+    if (!mask)
         return;
+
+    struct param_batch batch;
+    param_batch_init(&batch, app);
+    for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++)
+    {
+        if (!(mask & (UINT64_C(1) << ctl)))
+            continue;
+        if (ramp_engine_set_target(&app->ramps, ctl, values[ctl], app->ramp_tick_usec))
+            param_batch_add(&batch, ctl, values[ctl]);
     }
-    data->sources[source_idx].last_sofa_usec = now;
+    param_batch_send(&batch);
 
-    float center = data->sources[source_idx].azimuth;
-    float width = data->sources[source_idx].width;
-    float elevation = data->sources[source_idx].elevation;
-    float radius = data->sources[source_idx].radius;
-    float gain = data->sources[source_idx].fixed_loudness ? 1.0f : radius_to_gain(radius);
+    if (app->ramps.active)
+        ramp_timer_arm(app);
+}
 
-    float half = width * 0.5f;
+static void take_posted_controls(AppData *app)
+{
+    float values[CTL_COUNT];
+    uint64_t mask = command_ring_take_controls(&app->commands, values);
 
-    float left_az = center - half;
-    float right_az = center + half;
+    apply_control_values(app, values, mask);
+}
 
-    if (left_az < 0.0f)
-        left_az += 360.0f;
-    if (left_az >= 360.0f)
-        left_az -= 360.0f;
-    if (right_az < 0.0f)
-        right_az += 360.0f;
-    if (right_az >= 360.0f)
-        right_az -= 360.0f;
+/* Runs on the PipeWire thread whenever the command event is signalled */
+static void on_command_event(void *data, uint64_t count)
+{
+    (void)count;
+    AppData *app = data;
+    Command cmd;
 
-    const char *names[] = {left_names[source_idx], right_names[source_idx]};
-    const float azimuths[] = {left_az, right_az};
-    float bypass = data->sources[source_idx].bypass ? 1.0f : 0.0f;
-    int base_channel = source_idx * 2; /* 0-based */
+    while (command_ring_pop(&app->commands, &cmd))
+        run_command(app, &cmd);
+
+    take_posted_controls(app);
+}
+
+/*
+ * Interest filter: only playback streams, sinks and the spatializer are
+ * tracked in full. Other nodes, their ports and links touching those ports
+ * leave a one-byte tombstone so global_remove can drop them early.
+ */
+enum
+{
+    IGNORED_NODE = 1,
+    IGNORED_PORT,
+    IGNORED_LINK,
+};
+
+static bool node_class_is_tracked(const char *media_class)
+{
+    return media_class &&
+           (strcmp(media_class, "Stream/Output/Audio") == 0 ||
+            strcmp(media_class, "Audio/Sink") == 0);
+}
+
+/* Streams only matter through their outputs, sinks and the filter through their inputs */
+static bool port_is_tracked(const AppData *app, uint32_t node_id, int direction)
+{
+    if (app->filter_node_id != 0 && node_id == app->filter_node_id)
+        return direction == 0;
+
+    NodeInfo *ni = flatmap_lookup(&app->nodes, node_id);
+    if (!ni || !ni->media_class)
+        return false;
+    if (strcmp(ni->media_class, "Audio/Sink") == 0)
+        return direction == 0;
+    return direction == 1;
+}
+
+static void ignore_global(AppData *app, uint32_t id, uint8_t kind)
+{
+    uint8_t *tomb = flatmap_insert(&app->ignored, id);
+    if (tomb)
+        *tomb = kind;
+}
+
+static bool port_is_known(const AppData *app, uint32_t port_gid)
+{
+    return flatmap_lookup(&app->ports, port_gid) || flatmap_lookup(&app->ignored, port_gid);
+}
+
+/*
+ * A link into a filter input from an untracked node (an Audio/Source, a
+ * JACK or duplex client wired with pw-link) still mixes into that input.
+ * It is recorded with output node 0, which never owns a slot: the input
+ * counts as occupied until reconcile_orphan_links() removes the link.
+ */
+static bool track_foreign_filter_link(AppData *app, uint32_t id, uint32_t out_port_gid, const PortInfo *in_pi)
+{
+    if (app->filter_node_id == 0 || in_pi->node_id != app->filter_node_id || in_pi->direction != 0 ||
+        in_pi->port_id < 0 || in_pi->port_id >= 8)
+        return false;
+
+    LinkInfo info = {
+        .link_id = id,
+        .out_port_gid = out_port_gid,
+        .in_port_gid = in_pi->global_id,
+        .out_node_id = 0,
+        .filter_in_port_id = in_pi->port_id,
+    };
+    printf("[linkmgr] link id=%u into filter input %d comes from an untracked node; removing it\n",
+           id, in_pi->port_id);
+    link_table_insert(app, &info);
+    app->filter_in_occupied[in_pi->port_id] = true;
+    app->reconcile_orphans = true;
+    reconcile_request(app);
+    return true;
+}
 
-    /* avoid redundant updates to reduce artifact noise */
-    if (!params_changed(&data->sources[source_idx], center, elevation, radius, width, gain))
+/*
+ * Classifies a Link global and assigns it to a stereo slot. Returns false
+ * without side effects when either port has not been announced yet.
+ */
+static bool resolve_link(AppData *app, uint32_t id, uint32_t out_port_gid, uint32_t in_port_gid)
+{
+    if (flatmap_lookup(&app->ignored, in_port_gid))
     {
-        return;
+        ignore_global(app, id, IGNORED_LINK);
+        return true;
+    }
+    if (flatmap_lookup(&app->ignored, out_port_gid))
+    {
+        PortInfo *in_pi = flatmap_lookup(&app->ports, in_port_gid);
+        if (!in_pi)
+            return false;
+        if (!track_foreign_filter_link(app, id, out_port_gid, in_pi))
+            ignore_global(app, id, IGNORED_LINK);
+        return true;
     }
 
-    bool gain_changed = !data->sources[source_idx].last_valid ||
-                        fabsf(radius - data->sources[source_idx].last_radius) > 0.5f;
+    PortInfo *out_pi = flatmap_lookup(&app->ports, out_port_gid);
+    PortInfo *in_pi = flatmap_lookup(&app->ports, in_port_gid);
 
-    for (int i = 0; i < 2; i++)
+    if (!out_pi || !in_pi)
+        return false;
+
+    /* Prevent feedback: block effect_output → effect_input links */
+    NodeInfo *out_ni = flatmap_lookup(&app->nodes, out_pi->node_id);
+    NodeInfo *in_ni = flatmap_lookup(&app->nodes, in_pi->node_id);
+    if (out_ni && in_ni &&
+        out_ni->name && strstr(out_ni->name, "effect_output.multi_spatial") &&
+        in_ni->name && strstr(in_ni->name, "effect_input.multi_spatial"))
+    {
+        printf("[linkmgr] rejecting feedback link id=%u (%s -> %s)\n",
+               id, out_ni->name, in_ni->name);
+        destroy_link(app, id);
+        return true;
+    }
+
+    /* Filled on the stack; link_table_insert() copies it into app->links */
+    LinkInfo info = {0};
+    LinkInfo *li = &info;
+    li->link_id = id;
+    li->out_port_gid = out_port_gid;
+    li->in_port_gid = in_port_gid;
+    li->out_node_id = out_pi->node_id;
+    li->filter_in_port_id = -1;
+
+    if (out_pi->port_id >= 2)
+    {
+        printf("[linkmgr] rejecting non-stereo output: out port.id=%d (link id=%u)\n",
+               out_pi->port_id, id);
+        link_table_insert(app, li);
+        destroy_link(app, id);
+        return true;
+    }
+
+    if (app->filter_node_id != 0 && in_pi->node_id == app->filter_node_id && in_pi->direction == 0 &&
+        in_pi->port_id >= 0 && in_pi->port_id < 8)
     {
-        const char *spk_name = names[i];
-        float azimuth = mirror_azimuth(azimuths[i]);
-
-        printf("Setting SOFA controls for %s: azimuth=%.1f°, elevation=%.1f°, radius=%.1f\n",
-               spk_name, azimuth, elevation, radius);
-
-        struct param_data pd_az;
-        pd_az.proxy = data->filter_proxy;
-        snprintf(pd_az.name, sizeof(pd_az.name), "%.48s:Azimuth", spk_name);
-        pd_az.value = azimuth;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_az, sizeof(pd_az), false, NULL);
-
-        struct param_data pd_el;
-        pd_el.proxy = data->filter_proxy;
-        snprintf(pd_el.name, sizeof(pd_el.name), "%.46s:Elevation", spk_name);
-        pd_el.value = elevation;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_el, sizeof(pd_el), false, NULL);
-
-        struct param_data pd_rad;
-        pd_rad.proxy = data->filter_proxy;
-        snprintf(pd_rad.name, sizeof(pd_rad.name), "%.51s:Radius", spk_name);
-        pd_rad.value = radius;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_rad, sizeof(pd_rad), false, NULL);
-
-        struct param_data pd_bypass;
-        pd_bypass.proxy = data->filter_proxy;
-        snprintf(pd_bypass.name, sizeof(pd_bypass.name), "%.48s:Bypass", spk_name);
-        pd_bypass.value = bypass;
-        pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                       &pd_bypass, sizeof(pd_bypass), false, NULL);
-
-        if (gain_changed)
+        /* Until the initial sync, only record; adopt_existing_filter_links() assigns slots */
+        if (!app->initial_sync_done)
+        {
+            link_table_insert(app, li);
+            return true;
+        }
+
+        int slot = find_or_allocate_stereo_slot(app, out_pi->node_id);
+        if (slot < 0)
+        {
+            printf("[linkmgr] no free stereo slots for link id=%u\n", id);
+            link_table_insert(app, li);
+            app->reconcile_orphans = true;
+            reconcile_request(app);
+            return true;
+        }
+
+        app->sources[slot].source_node_id = out_pi->node_id;
+
+        int target_input = slot * 2 + out_pi->port_id;
+        if (app->sources[slot].bypass || in_pi->port_id != target_input)
+        {
+            /* Not part of the desired graph; the reconciler rewires the slot in one go */
+            printf("[linkmgr] link id=%u (node %u port.id=%d -> input %d) does not match slot %d%s\n",
+                   id, out_pi->node_id, out_pi->port_id, in_pi->port_id, slot,
+                   app->sources[slot].bypass ? " (bypassed)" : "");
+            link_table_insert(app, li);
+            reconcile_request(app);
+            return true;
+        }
+
+        /* A second link onto the same input is a duplicate for the reconciler to drop */
+        uint32_t *head = flatmap_lookup(&app->node_links, out_pi->node_id);
+        for (uint32_t lid = head ? *head : 0; lid;)
         {
-            struct param_data pd_gain;
-            pd_gain.proxy = data->filter_proxy;
-            int channel_id = base_channel + i + 1; /* 1..8 */
-            snprintf(pd_gain.name, sizeof(pd_gain.name), "mixL:Gain %d", channel_id);
-            pd_gain.value = gain;
-            pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                           &pd_gain, sizeof(pd_gain), false, NULL);
-
-            snprintf(pd_gain.name, sizeof(pd_gain.name), "mixR:Gain %d", channel_id);
-            pd_gain.value = gain;
-            pw_loop_invoke(pw_main_loop_get_loop(data->loop), do_set_param, 1,
-                           &pd_gain, sizeof(pd_gain), false, NULL);
+            LinkInfo *other = flatmap_lookup(&app->links, lid);
+            if (!other)
+                break;
+            if (other->in_port_gid == in_port_gid)
+            {
+                link_table_insert(app, li);
+                reconcile_request(app);
+                return true;
+            }
+            lid = other->node_next;
         }
+
+        li->filter_in_port_id = target_input;
+        app->filter_in_occupied[target_input] = true;
+
+        printf("[linkmgr] accepted stereo link id=%u slot=%d input=%d\n",
+               id, slot, target_input);
+
+        link_table_insert(app, li);
+        attach_slot_source(app, slot, out_pi->node_id);
+        return true;
+    }
+    else if (app->default_sink_node_id != 0 && in_pi->node_id == app->default_sink_node_id)
+    {
+        /* Sink links of a slot source are only wanted while it is bypassed */
+        int slot = find_stereo_slot(app, out_pi->node_id);
+        if (slot >= 0 && !app->sources[slot].bypass)
+            reconcile_request(app);
+    }
+
+    link_table_insert(app, li);
+    return true;
+}
+
+/* Parks a link until its ports are known and makes sure a core done follows */
+static void defer_link(AppData *app, uint32_t id, uint32_t out_port_gid, uint32_t in_port_gid)
+{
+    PendingLink *pl = flatmap_insert(&app->pending_links, id);
+    if (!pl)
+        return;
+    pl->out_port_gid = out_port_gid;
+    pl->in_port_gid = in_port_gid;
+
+    printf("[linkmgr] port metadata not ready for link id=%u; deferred (%u pending)\n",
+           id, flatmap_count(&app->pending_links));
+
+    if (app->pending_sync_seq == 0)
+    {
+        int seq = pw_core_sync(app->core, PW_ID_CORE, 0);
+        app->pending_sync_seq = seq > 0 ? seq : 0;
+    }
+}
+
+/*
+ * Retries deferred links. With port_gid != 0 only links touching that port
+ * are tried; port_gid == 0 retries all of them (core done).
+ */
+static void resolve_pending_links(AppData *app, uint32_t port_gid)
+{
+    uint32_t n = flatmap_count(&app->pending_links);
+    if (n == 0)
+        return;
+
+    /* Snapshot first: resolve_link() may create or destroy links and we remove entries */
+    uint32_t *ids = g_new(uint32_t, n);
+    PendingLink *links = g_new(PendingLink, n);
+    uint32_t ready = 0;
+
+    FlatMapIter iter;
+    uint32_t key;
+    void *value;
+    flatmap_iter_init(&iter, &app->pending_links);
+    while (flatmap_iter_next(&iter, &key, &value))
+    {
+        PendingLink *pl = value;
+        if (port_gid != 0 && pl->out_port_gid != port_gid && pl->in_port_gid != port_gid)
+            continue;
+        if (!port_is_known(app, pl->out_port_gid) || !port_is_known(app, pl->in_port_gid))
+            continue;
+        ids[ready] = key;
+        links[ready] = *pl;
+        ready++;
+    }
+
+    for (uint32_t i = 0; i < ready; i++)
+    {
+        flatmap_remove(&app->pending_links, ids[i]);
+        printf("[linkmgr] resolving deferred link id=%u\n", ids[i]);
+        resolve_link(app, ids[i], links[i].out_port_gid, links[i].in_port_gid);
     }
 
-    remember_params(&data->sources[source_idx], center, elevation, radius, width, gain);
+    g_free(ids);
+    g_free(links);
 }
 
 static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
@@ -811,6 +2608,22 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
 {
     AppData *app = data;
 
+    if (strcmp(type, PW_TYPE_INTERFACE_Metadata) == 0)
+    {
+        const char *name = spa_dict_lookup(props, PW_KEY_METADATA_NAME);
+        if (name && strcmp(name, "settings") == 0 && !app->settings_proxy)
+        {
+            app->settings_id = id;
+            app->settings_proxy = pw_registry_bind(app->registry, id,
+                                                   PW_TYPE_INTERFACE_Metadata,
+                                                   PW_VERSION_METADATA, 0);
+            if (app->settings_proxy)
+                pw_metadata_add_listener((struct pw_metadata *)app->settings_proxy,
+                                         &app->settings_listener, &settings_events, app);
+        }
+        return;
+    }
+
     if (strcmp(type, PW_TYPE_INTERFACE_Node) == 0)
     {
         const char *node_name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
@@ -826,13 +2639,32 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
                                                  PW_TYPE_INTERFACE_Node,
                                                  PW_VERSION_NODE,
                                                  0);
+            if (app->filter_proxy)
+            {
+                uint32_t ids[] = {SPA_PARAM_Props, SPA_PARAM_Latency};
+                app->controls_synced = false;
+                app->props_sent_usec = 0;
+                app->props_sync_seq = 0;
+                pw_node_add_listener((struct pw_node *)app->filter_proxy, &app->filter_listener,
+                                     &filter_node_events, app);
+                pw_node_subscribe_params((struct pw_node *)app->filter_proxy, ids, 2);
+            }
 
-            /* Start with all mixer gains muted to avoid stale buffers before links appear */
-            for (int i = 0; i < MAX_SOURCES; i++)
+            control_table_build(&app->controls);
+            ramp_engine_reset(&app->ramps);
+            app->group_mask = 0;
+
+            /* Start with all mixer gains muted to avoid stale buffers before links appear.
+             * On a warm start, adopt_existing_filter_links() mutes only the slots it does not adopt */
+            if (app->initial_sync_done)
             {
-                set_slot_gain(app, i, 0.0f);
-                app->sources[i].last_valid = false;
-                app->sources[i].last_sofa_usec = 0;
+                struct param_batch batch;
+                param_batch_init(&batch, app);
+                for (int i = 0; i < MAX_SOURCES; i++)
+                {
+                    add_slot_gain(&batch, i, 0.0f);
+                }
+                param_batch_commit(app, &batch);
             }
 
             const char *source_names[] = {"spk1/spk2", "spk3/spk4", "spk5/spk6", "spk7/spk8"};
@@ -842,35 +2674,34 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
                 app->sources[i].index = i;
                 app->sources[i].active = true;
                 strncpy(app->sources[i].name, source_names[i], sizeof(app->sources[i].name) - 1);
+                g_mutex_lock(&app->positions_lock);
                 app->sources[i].azimuth = (i == 3) ? 270.0f : 0.0f;
                 app->sources[i].elevation = 0.0f;
                 app->sources[i].radius = 50.0f;
+                g_mutex_unlock(&app->positions_lock);
                 app->sources[i].fixed_loudness = false;
                 app->sources[i].is_playing = false;
+                app->sources[i].seed_from_filter = false;
 
-                if (app->source_labels[i])
-                {
-                    char label_text[64];
-                    snprintf(label_text, sizeof(label_text), "Source %d (%s)", i + 1, source_names[i]);
-                    gtk_label_set_text(GTK_LABEL(app->source_labels[i]), label_text);
-                }
-
-                if (app->elevation_sliders[i])
-                {
-                    gtk_widget_set_sensitive(app->elevation_sliders[i], false);
-                }
-                if (app->bypass_checkboxes[i])
-                {
-                    gtk_widget_set_sensitive(app->bypass_checkboxes[i], true);
-                }
+                char label_text[64];
+                snprintf(label_text, sizeof(label_text), "Source %d (%s)", i + 1, source_names[i]);
+                ui_mailbox_set_source_label(&app->mailbox, i, label_text);
+                ui_mailbox_set_sensitivity(&app->mailbox, i, false, true);
+                publish_canvas_slot(app, i);
             }
 
-            refresh_canvas(app);
+            ui_mailbox_queue_redraw(&app->mailbox);
+            return;
+        }
+
+        if (!node_class_is_tracked(media_class))
+        {
+            ignore_global(app, id, IGNORED_NODE);
             return;
         }
 
         /* cache node info for display */
-        replace_node_info(app, id, node_info_new(props));
+        replace_node_info(app, id, props);
 
         if (app->default_sink_node_id == 0 && media_class && strcmp(media_class, "Audio/Sink") == 0)
         {
@@ -889,13 +2720,26 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
             return;
         }
 
-        PortInfo *pi = g_new0(PortInfo, 1);
+        if (!port_is_tracked(app, (uint32_t)atoi(node_id_s), (strcmp(dir_s, "in") == 0) ? 0 : 1))
+        {
+            ignore_global(app, id, IGNORED_PORT);
+            resolve_pending_links(app, id);
+            return;
+        }
+
+        PortInfo *pi = flatmap_lookup(&app->ports, id);
+        if (pi)
+            port_index_remove(app, pi);
+        else
+            pi = flatmap_insert(&app->ports, id);
+        if (!pi)
+            return;
+
         pi->global_id = id;
         pi->node_id = (uint32_t)atoi(node_id_s);
         pi->direction = (strcmp(dir_s, "in") == 0) ? 0 : 1;
         pi->port_id = atoi(port_id_s);
-
-        g_hash_table_replace(app->ports, u32key(id), pi);
+        port_index_insert(app, pi);
 
         if (app->filter_node_id != 0 && pi->node_id == app->filter_node_id)
         {
@@ -906,6 +2750,8 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
                        pi->port_id, pi->global_id);
             }
         }
+
+        resolve_pending_links(app, id);
         return;
     }
 
@@ -923,135 +2769,11 @@ static void registry_event_global(void *data, uint32_t id, uint32_t permissions,
         uint32_t out_port_gid = (uint32_t)atoi(out_port_s);
         uint32_t in_port_gid = (uint32_t)atoi(in_port_s);
 
-        PortInfo *out_pi = g_hash_table_lookup(app->ports, u32key(out_port_gid));
-        PortInfo *in_pi = g_hash_table_lookup(app->ports, u32key(in_port_gid));
-
         printf("[registry] LINK id=%u out_port_gid=%u in_port_gid=%u\n",
                id, out_port_gid, in_port_gid);
 
-        if (!out_pi || !in_pi)
-        {
-            printf("[linkmgr] port metadata not ready for link id=%u (out_pi=%p in_pi=%p)\n",
-                   id, (void *)out_pi, (void *)in_pi);
-            return;
-        }
-
-        /* Prevent feedback: block effect_output → effect_input links */
-        NodeInfo *out_ni = g_hash_table_lookup(app->nodes, u32key(out_pi->node_id));
-        NodeInfo *in_ni = g_hash_table_lookup(app->nodes, u32key(in_pi->node_id));
-        if (out_ni && in_ni &&
-            out_ni->name && strstr(out_ni->name, "effect_output.multi_spatial") &&
-            in_ni->name && strstr(in_ni->name, "effect_input.multi_spatial"))
-        {
-            printf("[linkmgr] rejecting feedback link id=%u (%s -> %s)\n",
-                   id, out_ni->name, in_ni->name);
-            destroy_link(app, id);
-            return;
-        }
-
-        LinkInfo *li = g_new0(LinkInfo, 1);
-        li->link_id = id;
-        li->out_port_gid = out_port_gid;
-        li->in_port_gid = in_port_gid;
-        li->out_node_id = out_pi->node_id;
-        li->filter_in_port_id = -1;
-
-        if (out_pi->port_id >= 2)
-        {
-            printf("[linkmgr] rejecting non-stereo output: out port.id=%d (link id=%u)\n",
-                   out_pi->port_id, id);
-            g_hash_table_replace(app->links, u32key(id), li);
-            destroy_link(app, id);
-            return;
-        }
-
-        if (app->filter_node_id != 0 && in_pi->node_id == app->filter_node_id && in_pi->direction == 0)
-        {
-            int in_port_id = in_pi->port_id;
-            if (in_port_id >= 0 && in_port_id < 8)
-            {
-
-                li->filter_in_port_id = in_port_id;
-
-                if (app->filter_node_id != 0 && in_pi->node_id == app->filter_node_id && in_pi->direction == 0)
-                {
-
-                    int slot = find_or_allocate_stereo_slot(app, out_pi->node_id);
-                    if (slot < 0)
-                    {
-                        printf("[linkmgr] no free stereo slots; destroying link id=%u\n", id);
-                        destroy_link(app, id);
-                        return;
-                    }
-
-                    app->sources[slot].source_node_id = out_pi->node_id;
-
-                    int base_input = slot * 2;
-                    int target_input = base_input + out_pi->port_id;
-
-                    if (target_input < 0 || target_input >= 8)
-                    {
-                        destroy_link(app, id);
-                        return;
-                    }
-
-                    uint32_t target_in_gid = app->filter_in_gid[target_input];
-                    if (!target_in_gid)
-                    {
-                        destroy_link(app, id);
-                        return;
-                    }
-
-                    if (app->sources[slot].bypass)
-                    {
-                        printf("[linkmgr] bypass active; dropping link id=%u for slot %d\n", id, slot);
-                        destroy_link(app, id);
-                        create_sink_links(app, slot);
-                        return;
-                    }
-
-                    if (in_pi->port_id != target_input)
-                    {
-                        /* If the desired input is already occupied by the same slot, just drop this stray link to avoid flapping */
-                        if (app->filter_in_occupied[target_input])
-                        {
-                            printf("[linkmgr] dropping stray stereo link id=%u (node %u port.id=%d) because target input %d already in use\n",
-                                   id, out_pi->node_id, out_pi->port_id, target_input);
-                            destroy_link(app, id);
-                            return;
-                        }
-
-                        printf("[linkmgr] correcting stereo link: node %u port.id=%d → filter input %d\n",
-                               out_pi->node_id, out_pi->port_id, target_input);
-
-                        destroy_link(app, id);
-                        create_link(app, out_port_gid, target_in_gid);
-                        return;
-                    }
-
-                    li->filter_in_port_id = target_input;
-                    app->filter_in_occupied[target_input] = true;
-
-                    printf("[linkmgr] accepted stereo link id=%u slot=%d input=%d\n",
-                           id, slot, target_input);
-
-                    NodeInfo *ni = g_hash_table_lookup(app->nodes, u32key(out_pi->node_id));
-                    set_source_label(app, slot, node_label(ni));
-                    app->sources[slot].fixed_loudness = node_is_fixed_loudness(ni);
-                    if (app->sources[slot].fixed_loudness)
-                    {
-                        printf("[source] slot %d fixed loudness enabled (node=%u app_name=%s)\n",
-                               slot,
-                               out_pi->node_id,
-                               (ni && ni->app_name) ? ni->app_name : "(unknown)");
-                    }
-
-                    apply_connection_state(app, slot);
-                }
-            }
-        }
-
-        g_hash_table_replace(app->links, u32key(id), li);
+        if (!resolve_link(app, id, out_port_gid, in_port_gid))
+            defer_link(app, id, out_port_gid, in_port_gid);
         return;
     }
 }
@@ -1060,28 +2782,50 @@ static void registry_event_global_remove(void *data, uint32_t id)
 {
     AppData *app = data;
 
-    LinkInfo *li = g_hash_table_lookup(app->links, u32key(id));
+    if (flatmap_remove(&app->ignored, id))
+        return;
+
+    if (app->settings_proxy && id == app->settings_id)
+    {
+        spa_hook_remove(&app->settings_listener);
+        pw_proxy_destroy(app->settings_proxy);
+        app->settings_proxy = NULL;
+        return;
+    }
+
+    link_op_link_removed(app, id);
+
+    if (flatmap_remove(&app->pending_links, id))
+        return;
+
+    LinkInfo *li = flatmap_lookup(&app->links, id);
     if (li)
     {
-        if (li->filter_in_port_id >= 0 && li->filter_in_port_id < 8)
+        /* A foreign link on an input one of our slots also feeds leaves that input occupied */
+        bool foreign_on_owned = li->out_node_id == 0 && li->filter_in_port_id >= 0 &&
+                                app->stereo_slots[li->filter_in_port_id / 2].occupied;
+        if (li->filter_in_port_id >= 0 && li->filter_in_port_id < 8 && !foreign_on_owned)
         {
             app->filter_in_occupied[li->filter_in_port_id] = false;
             printf("[linkmgr] link removed id=%u freed filter input port.id=%d\n",
                    id, li->filter_in_port_id);
 
             int slot = li->filter_in_port_id / 2;
-            apply_connection_state(app, slot);
+            mark_slot_dirty(app, slot);
             if (!app->filter_in_occupied[li->filter_in_port_id ^ 1])
             {
                 free_stereo_slot(app, li->out_node_id);
             }
         }
-        g_hash_table_remove(app->links, u32key(id));
+        link_table_remove(app, id);
     }
 
-    if (g_hash_table_contains(app->ports, u32key(id)))
+    PortInfo *pi = flatmap_lookup(&app->ports, id);
+    if (pi)
     {
-        g_hash_table_remove(app->ports, u32key(id));
+        port_index_remove(app, pi);
+        flatmap_remove(&app->ports, id);
+        flatmap_remove(&app->link_retries, id);
         return;
     }
 
@@ -1089,6 +2833,22 @@ static void registry_event_global_remove(void *data, uint32_t id)
     {
         printf("Multi-Source Spatializer node removed (id: %u)\n", id);
         app->filter_node_id = 0;
+        control_table_clear(&app->controls);
+        ramp_engine_reset(&app->ramps);
+        app->group_mask = 0;
+        app->props_sent_usec = 0;
+        app->props_sync_seq = 0;
+        app->node_latency_usec = 0;
+        app->filter_driver_id = 0;
+        clock_probe_join_group(app, NULL);
+        ramp_timer_disarm(app);
+        if (app->filter_proxy)
+        {
+            spa_hook_remove(&app->filter_listener);
+            pw_proxy_destroy(app->filter_proxy);
+            app->filter_proxy = NULL;
+        }
+        control_socket_synced(app->control_socket);
 
         for (int i = 0; i < 8; i++)
         {
@@ -1096,42 +2856,23 @@ static void registry_event_global_remove(void *data, uint32_t id)
             app->filter_in_occupied[i] = false;
         }
 
-        if (g_hash_table_contains(app->nodes, u32key(id)))
-        {
-            g_hash_table_remove(app->nodes, u32key(id));
-        }
-
         for (int i = 0; i < MAX_SOURCES; i++)
         {
             app->sources[i].active = false;
             app->sources[i].is_playing = false;
-            if (app->source_labels[i])
-            {
-                gtk_label_set_text(GTK_LABEL(app->source_labels[i]), "No source");
-            }
-            if (app->elevation_sliders[i])
-            {
-                gtk_widget_set_sensitive(app->elevation_sliders[i], false);
-            }
-            if (app->width_sliders[i])
-            {
-                gtk_widget_set_sensitive(app->width_sliders[i], false);
-            }
-            if (app->bypass_checkboxes[i])
-            {
-                gtk_widget_set_sensitive(app->bypass_checkboxes[i], false);
-            }
+            ui_mailbox_set_source_label(&app->mailbox, i, "No source");
+            ui_mailbox_set_sensitivity(&app->mailbox, i, false, false);
+            publish_canvas_slot(app, i);
         }
 
-        refresh_canvas(app);
+        ui_mailbox_queue_redraw(&app->mailbox);
     }
 
-    if (g_hash_table_contains(app->nodes, u32key(id)))
+    NodeInfo *ni = flatmap_lookup(&app->nodes, id);
+    if (ni)
     {
-        NodeInfo *old = g_hash_table_lookup(app->nodes, u32key(id));
-        if (old)
-            node_info_free(old);
-        g_hash_table_remove(app->nodes, u32key(id));
+        node_info_clear(app, ni);
+        flatmap_remove(&app->nodes, id);
     }
 }
 
@@ -1146,19 +2887,64 @@ static void on_core_error(void *data, uint32_t id, int seq, int res, const char
     fprintf(stderr, "PipeWire core error: %s\n", message);
 }
 
+/* Commit phase: fix up links first, then settle each touched slot exactly once */
+static void commit_registry(AppData *app)
+{
+    if (app->reconcile_pending)
+    {
+        app->reconcile_pending = false;
+        reconcile_links(app);
+    }
+
+    uint32_t dirty = app->dirty_slots;
+    app->dirty_slots = 0;
+    for (int slot = 0; slot < MAX_SOURCES; slot++)
+    {
+        if (dirty & (1u << slot))
+            apply_connection_state(app, slot);
+    }
+}
+
 static void on_core_done(void *data, uint32_t id, int seq)
 {
     AppData *app = data;
 
+    if (app->pending_sync_seq != 0 && seq == app->pending_sync_seq)
+    {
+        app->pending_sync_seq = 0;
+        resolve_pending_links(app, 0);
+        if (flatmap_count(&app->pending_links) > 0)
+            printf("[linkmgr] %u links still waiting for port metadata\n",
+                   flatmap_count(&app->pending_links));
+    }
+
+    if (app->props_sync_seq != 0 && seq == app->props_sync_seq)
+    {
+        app->props_sync_seq = 0;
+        control_shadow_synced(&app->controls, app->props_sync_gen);
+        control_socket_synced(app->control_socket);
+        if (app->controls.send_gen != app->props_sync_gen)
+            props_sync_request(app);
+    }
+
+    if (app->commit_seq != 0 && seq == app->commit_seq)
+    {
+        app->commit_seq = 0;
+        commit_registry(app);
+    }
+
     if (seq != (int)app->sync_seq || app->initial_sync_done)
         return;
 
-    printf("[startup] registry sync complete\n");
+    printf("[startup] registry sync complete: tracking %u nodes, %u ports, %u links; "
+           "%u globals ignored (%zu bytes)\n",
+           flatmap_count(&app->nodes), flatmap_count(&app->ports), flatmap_count(&app->links),
+           flatmap_count(&app->ignored), flatmap_memory(&app->ignored));
 
     app->initial_sync_done = true;
 
     if (app->filter_node_id != 0)
-        cleanup_existing_filter_links(app);
+        adopt_existing_filter_links(app);
 }
 
 static const struct pw_core_events core_events = {
@@ -1171,6 +2957,15 @@ bool init_pipewire(AppData *data)
 {
     pw_init(NULL, NULL);
 
+    data->sofa_resolution = sofa_resolution_from_env();
+    if (data->sofa_resolution == SOFA_RESOLUTION_GRID)
+    {
+        char *sofa_path = sofa_grid_find_file();
+        if (!sofa_grid_load(&data->sofa_grid, sofa_path))
+            printf("[sofa] no measurement grid; sending positions at exact resolution\n");
+        g_free(sofa_path);
+    }
+
     data->loop = pw_main_loop_new(NULL);
     if (!data->loop)
     {
@@ -1194,11 +2989,44 @@ bool init_pipewire(AppData *data)
 
     pw_core_add_listener(data->core, &data->core_listener, &core_events, data);
 
+    data->command_event = pw_loop_add_event(pw_main_loop_get_loop(data->loop),
+                                            on_command_event, data);
+    if (!data->command_event)
+    {
+        fprintf(stderr, "Failed to create command event\n");
+        return false;
+    }
+
+    data->link_op_timer = pw_loop_add_timer(pw_main_loop_get_loop(data->loop),
+                                            on_link_op_timer, data);
+    data->link_retry_timer = pw_loop_add_timer(pw_main_loop_get_loop(data->loop),
+                                               on_link_retry_timer, data);
+    data->seed_timer = pw_loop_add_timer(pw_main_loop_get_loop(data->loop), on_seed_timer, data);
+
+    const char *ramp_ms_s = g_getenv("PW_MIXER_RAMP_MS");
+    int ramp_ms = ramp_ms_s ? atoi(ramp_ms_s) : RAMP_MS_DEFAULT;
+    ramp_engine_init(&data->ramps, ramp_ms > 0 ? (uint32_t)ramp_ms * 1000 : 0);
+    update_ramp_tick(data);
+    data->ramp_timer = pw_loop_add_timer(pw_main_loop_get_loop(data->loop),
+                                         on_ramp_timer, data);
+
+    const char *align_s = g_getenv("PW_MIXER_ALIGN_GROUPS");
+    data->align_groups = !align_s || atoi(align_s) != 0;
+
+    const char *predict_s = g_getenv("PW_MIXER_PREDICT");
+    data->predict_listener = !predict_s || atoi(predict_s) != 0;
+    if (data->align_groups)
+        clock_probe_start(data);
+
     data->registry = pw_core_get_registry(data->core, PW_VERSION_REGISTRY, 0);
     pw_registry_add_listener(data->registry, &data->registry_listener, &registry_events, data);
 
     data->sync_seq = pw_core_sync(data->core, 0, 1);
 
+    data->control_socket = control_socket_start(data);
+    data->shm_state = shm_state_start(data);
+    data->osc_input = osc_input_start(data);
+
     printf("Connected to PipeWire\n");
     printf("Looking for 'effect_input.multi_spatial' filter-chain node...\n");
     return true;
@@ -1207,14 +3035,74 @@ bool init_pipewire(AppData *data)
 gpointer pipewire_thread(gpointer user_data)
 {
     AppData *data = user_data;
+    data->pw_thread = g_thread_self();
     pw_main_loop_run(data->loop);
     return NULL;
 }
 
 void shutdown_pipewire(AppData *data)
 {
+    control_socket_stop(data->control_socket);
+    data->control_socket = NULL;
+    shm_state_stop(data->shm_state);
+    data->shm_state = NULL;
+    osc_input_stop(data->osc_input);
+    data->osc_input = NULL;
+    if (data->clock_probe)
+    {
+        spa_hook_remove(&data->clock_probe_listener);
+        pw_filter_destroy(data->clock_probe);
+    }
+    if (data->cycle_event)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->cycle_event);
+    if (data->command_event)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->command_event);
+    if (data->link_op_timer)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->link_op_timer);
+    if (data->link_retry_timer)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->link_retry_timer);
+    if (data->seed_timer)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->seed_timer);
+    if (data->ramp_timer)
+        pw_loop_destroy_source(pw_main_loop_get_loop(data->loop), data->ramp_timer);
+    if (data->settings_proxy)
+    {
+        spa_hook_remove(&data->settings_listener);
+        pw_proxy_destroy(data->settings_proxy);
+    }
+
+    FlatMapIter iter;
+    void *value;
+    uint32_t key;
+
+    /* Drop proxies of creates still in flight; their destroy events empty link_ops */
+    for (bool found = true; found;)
+    {
+        found = false;
+        flatmap_iter_init(&iter, &data->link_ops);
+        while (flatmap_iter_next(&iter, &key, &value))
+        {
+            LinkOp *op = value;
+            if (op->proxy)
+            {
+                struct pw_proxy *proxy = op->proxy;
+                op->proxy = NULL;
+                pw_proxy_destroy(proxy);
+                found = true;
+                break;
+            }
+        }
+    }
+
+    flatmap_iter_init(&iter, &data->nodes);
+    while (flatmap_iter_next(&iter, NULL, &value))
+        node_info_clear(data, value);
+
     if (data->filter_proxy)
+    {
+        spa_hook_remove(&data->filter_listener);
         pw_proxy_destroy(data->filter_proxy);
+    }
     if (data->registry)
         pw_proxy_destroy((struct pw_proxy *)data->registry);
     if (data->core)
@@ -1224,6 +3112,7 @@ void shutdown_pipewire(AppData *data)
     if (data->loop)
         pw_main_loop_destroy(data->loop);
 
+    sofa_grid_clear(&data->sofa_grid);
     pw_deinit();
 }
 #include <stdbool.h>
@@ -9,8 +9,14 @@ bool init_pipewire(AppData *data);
 gpointer pipewire_thread(gpointer user_data);
 void shutdown_pipewire(AppData *data);
 void send_sofa_control(AppData *data, int source_idx);
+void send_sofa_controls(AppData *data, guint source_mask);
+void set_listener_orientation(AppData *data, float yaw, float pitch, float roll);
+void track_listener_orientation(AppData *data, float yaw, float pitch, float roll, gint64 sample_usec);
+bool apply_tracked_orientation(AppData *data, bool fresh);
 void relink_stereo_to_filter(AppData *data, int source_idx);
 void unlink_all_filter_inputs(AppData *app);
 void set_source_bypass(AppData *app, int source_idx, bool bypass);
+void assign_source_slot(AppData *app, int slot, uint32_t node_id);
+uint32_t controls_handoff_gen(AppData *app);
 
 #endif /* PW_MIXER_PIPEWIRE_H */
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <string.h>
+#include "ramp.h"
+
+static bool control_is_ramped(uint32_t ctl)
+{
+    if (ctl >= CTL_GAIN_BASE)
+        return ctl < CTL_COUNT;
+    return ctl % CTL_PARAMS_PER_SPK != CTL_PARAM_BYPASS;
+}
+
+static bool control_is_azimuth(uint32_t ctl)
+{
+    return ctl < CTL_GAIN_BASE && ctl % CTL_PARAMS_PER_SPK == CTL_PARAM_AZIMUTH;
+}
+
+static float wrap_degrees(float az)
+{
+    az = fmodf(az, 360.0f);
+    if (az < 0.0f)
+        az += 360.0f;
+    return az;
+}
+
+void ramp_engine_init(RampEngine *engine, uint32_t ramp_usec)
+{
+    memset(engine, 0, sizeof(*engine));
+    engine->ramp_usec = ramp_usec;
+}
+
+/* Forget what the node holds, e.g. when the filter is recreated */
+void ramp_engine_reset(RampEngine *engine)
+{
+    memset(engine->ramps, 0, sizeof(engine->ramps));
+    engine->active = 0;
+}
+
+/*
+ * Starts a ramp from the current value towards value. Returns true when the
+ * value has to go out right away instead: ramping is off, the control is a
+ * switch, or nothing has been sent for it yet.
+ */
+bool ramp_engine_set_target(RampEngine *engine, uint32_t ctl, float value, uint32_t tick_usec)
+{
+    if (ctl >= CTL_COUNT)
+        return false;
+
+    ControlRamp *r = &engine->ramps[ctl];
+    uint64_t bit = UINT64_C(1) << ctl;
+
+    if (engine->ramp_usec == 0 || tick_usec == 0 || !control_is_ramped(ctl) || !r->valid) {
+        r->current = r->target = value;
+        r->steps_left = 0;
+        r->valid = true;
+        engine->active &= ~bit;
+        return true;
+    }
+
+    float delta = value - r->current;
+    if (control_is_azimuth(ctl)) {
+        /* Values are already mirrored; mirroring keeps arc lengths, so the shorter arc is still shorter */
+        delta = fmodf(delta + 540.0f, 360.0f) - 180.0f;
+        value = wrap_degrees(value);
+    }
+
+    uint32_t steps = (engine->ramp_usec + tick_usec - 1) / tick_usec;
+    if (steps == 0)
+        steps = 1;
+
+    r->target = value;
+    r->step = delta / (float)steps;
+    r->steps_left = steps;
+    engine->active |= bit;
+    return false;
+}
+
+/* Advances every active ramp by one tick; returns the mask of controls written to values */
+uint64_t ramp_engine_tick(RampEngine *engine, float values[CTL_COUNT])
+{
+    uint64_t emitted = engine->active;
+
+    for (uint32_t ctl = 0; ctl < CTL_COUNT; ctl++) {
+        uint64_t bit = UINT64_C(1) << ctl;
+        if (!(emitted & bit))
+            continue;
+
+        ControlRamp *r = &engine->ramps[ctl];
+        if (--r->steps_left == 0) {
+            r->current = r->target;
+            engine->active &= ~bit;
+        } else {
+            r->current += r->step;
+            if (control_is_azimuth(ctl))
+                r->current = wrap_degrees(r->current);
+        }
+        values[ctl] = r->current;
+    }
+
+    return emitted;
+}
@@ -0,0 +1,32 @@
+#ifndef PW_MIXER_RAMP_H
+#define PW_MIXER_RAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "controls.h"
+
+typedef struct {
+    float current;          /* value last emitted */
+    float target;
+    float step;             /* per tick; azimuth steps follow the shorter arc */
+    uint32_t steps_left;
+    bool valid;             /* current reflects what was sent */
+} ControlRamp;
+
+/*
+ * Linear per-control ramps advanced by a control tick on the PipeWire
+ * thread. Azimuth, elevation, radius and mixer gains are ramped; bypass
+ * switches are passed through unchanged.
+ */
+typedef struct {
+    ControlRamp ramps[CTL_COUNT];
+    uint64_t active;        /* bit per control still moving */
+    uint32_t ramp_usec;     /* 0 disables ramping */
+} RampEngine;
+
+void ramp_engine_init(RampEngine *engine, uint32_t ramp_usec);
+void ramp_engine_reset(RampEngine *engine);
+bool ramp_engine_set_target(RampEngine *engine, uint32_t ctl, float value, uint32_t tick_usec);
+uint64_t ramp_engine_tick(RampEngine *engine, float values[CTL_COUNT]);
+
+#endif /* PW_MIXER_RAMP_H */
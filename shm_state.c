@@ -0,0 +1,261 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib.h>
+#include <pipewire/pipewire.h>
+#include "control_socket.h"
+#include "mixer_shm.h"
+#include "pipewire.h"
+#include "shm_state.h"
+
+G_STATIC_ASSERT(MIXER_SHM_SOURCES == MAX_SOURCES);
+
+struct ShmState {
+    AppData *app;
+    struct pw_loop *loop;
+    struct spa_source *timer;
+    char *name;
+    MixerShmBlock *block;
+    uint32_t target_seq;         /* last target generation applied */
+    bool listener_moving;        /* last pose sent was extrapolated; settle it on later ticks */
+    MixerShmTargets targets;     /* as of target_seq */
+    MixerShmState published;     /* last state written to the block */
+    uint64_t reads_failed;
+};
+
+/* Turns the fields of one target that changed since the last read into an update */
+static bool target_changes(const MixerShmTarget *now, const MixerShmTarget *before, int slot,
+                           MixerSourceUpdate *u)
+{
+    memset(u, 0, sizeof(*u));
+    u->slot = (uint8_t)slot;
+
+    uint32_t fields = now->fields;
+    uint32_t fresh = fields & ~before->fields;
+
+    if ((fields & MIXER_SET_AZIMUTH) && ((fresh & MIXER_SET_AZIMUTH) || now->azimuth != before->azimuth))
+        u->fields |= MIXER_SET_AZIMUTH;
+    if ((fields & MIXER_SET_ELEVATION) && ((fresh & MIXER_SET_ELEVATION) || now->elevation != before->elevation))
+        u->fields |= MIXER_SET_ELEVATION;
+    if ((fields & MIXER_SET_RADIUS) && ((fresh & MIXER_SET_RADIUS) || now->radius != before->radius))
+        u->fields |= MIXER_SET_RADIUS;
+    if ((fields & MIXER_SET_WIDTH) && ((fresh & MIXER_SET_WIDTH) || now->width != before->width))
+        u->fields |= MIXER_SET_WIDTH;
+    if ((fields & MIXER_SET_BYPASS) && ((fresh & MIXER_SET_BYPASS) || now->bypass != before->bypass))
+        u->fields |= MIXER_SET_BYPASS;
+    if ((fields & MIXER_SET_NODE) && ((fresh & MIXER_SET_NODE) || now->node_id != before->node_id))
+        u->fields |= MIXER_SET_NODE;
+
+    u->azimuth = now->azimuth;
+    u->elevation = now->elevation;
+    u->radius = now->radius;
+    u->width = now->width;
+    u->bypass = now->bypass;
+    u->node_id = now->node_id;
+    return u->fields != 0;
+}
+
+/* Applies a new target generation; returns true if the listener pose changed */
+static bool pick_up_targets(ShmState *shm)
+{
+    MixerShmBlock *block = shm->block;
+    MixerShmTargets targets;
+    uint32_t seq;
+
+    /* Cheap check first: nothing new unless the writer bumped the sequence */
+    if (__atomic_load_n(&block->target_seq, __ATOMIC_ACQUIRE) == shm->target_seq)
+        return false;
+    if (!mixer_shm_read(&block->target_seq, &targets, &block->targets, sizeof(targets), &seq)) {
+        shm->reads_failed++;
+        return false;
+    }
+
+    MixerSourceUpdate updates[MIXER_SHM_SOURCES];
+    uint16_t count = 0;
+    for (int i = 0; i < MIXER_SHM_SOURCES; i++) {
+        if (target_changes(&targets.sources[i], &shm->targets.sources[i], i, &updates[count]))
+            count++;
+    }
+    if (count > 0)
+        control_apply_updates(shm->app, updates, count);
+
+    const MixerShmOrientation *o = &targets.listener;
+    /* The block carries no sample time; the read is the closest stamp there is */
+    bool listener_changed = memcmp(o, &shm->targets.listener, sizeof(*o)) != 0;
+    if (listener_changed) {
+        track_listener_orientation(shm->app, o->yaw, o->pitch, o->roll, g_get_monotonic_time());
+        shm->listener_moving = apply_tracked_orientation(shm->app, true);
+    }
+
+    shm->targets = targets;
+    shm->target_seq = seq;
+    return listener_changed;
+}
+
+/* Writes the live state for readers if it changed; PipeWire thread only, the single writer */
+void shm_state_publish(ShmState *shm)
+{
+    MixerShmState state;
+
+    memset(&state, 0, sizeof(state));
+    for (int i = 0; i < MIXER_SHM_SOURCES; i++) {
+        const AudioSource *src = &shm->app->sources[i];
+        MixerShmSource *out = &state.sources[i];
+        g_mutex_lock(&shm->app->positions_lock);
+        out->azimuth = src->azimuth;
+        out->elevation = src->elevation;
+        out->radius = src->radius;
+        out->width = src->width;
+        g_mutex_unlock(&shm->app->positions_lock);
+        out->bypass = src->bypass;
+        out->is_playing = src->is_playing;
+        g_strlcpy(out->app_label, src->app_label, sizeof(out->app_label));
+    }
+
+    g_mutex_lock(&shm->app->listener_lock);
+    state.listener.yaw = shm->app->listener_yaw;
+    state.listener.pitch = shm->app->listener_pitch;
+    state.listener.roll = shm->app->listener_roll;
+    g_mutex_unlock(&shm->app->listener_lock);
+
+    /* Readers only see a new generation when something actually changed */
+    if (memcmp(&state, &shm->published, sizeof(state)) == 0)
+        return;
+
+    mixer_shm_write(&shm->block->state_seq, &shm->block->state, &state, sizeof(state));
+    shm->published = state;
+}
+
+static void on_shm_tick(void *data, uint64_t expirations)
+{
+    (void)expirations;
+    ShmState *shm = data;
+
+    if (!pick_up_targets(shm) && shm->listener_moving)
+        shm->listener_moving = apply_tracked_orientation(shm->app, false);
+    shm_state_publish(shm);
+}
+
+#define SHM_HEADER_SIZE offsetof(MixerShmBlock, state_seq)
+
+/* Pid of the live controller that owns an existing block, 0 if the block is stale */
+static pid_t shm_block_owner(const char *shm_name)
+{
+    int fd = shm_open(shm_name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return 0;
+
+    pid_t owner = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= SHM_HEADER_SIZE) {
+        const MixerShmBlock *block = mmap(NULL, SHM_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if (block != MAP_FAILED) {
+            owner = (pid_t)__atomic_load_n(&block->owner_pid, __ATOMIC_ACQUIRE);
+            munmap((void *)block, SHM_HEADER_SIZE);
+        }
+    }
+    close(fd);
+
+    if (owner > 0 && kill(owner, 0) < 0 && errno == ESRCH)
+        owner = 0;
+    return owner;
+}
+
+/* Creates the block exclusively; a stale one left by a crashed controller is replaced */
+static int shm_create(const char *shm_name)
+{
+    int fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0 || errno != EEXIST)
+        return fd;
+
+    pid_t owner = shm_block_owner(shm_name);
+    if (owner > 0) {
+        fprintf(stderr, "[shm] %s belongs to running controller pid %d; shared memory disabled\n",
+                shm_name, (int)owner);
+        errno = EBUSY;
+        return -1;
+    }
+
+    printf("[shm] replacing stale block %s\n", shm_name);
+    shm_unlink(shm_name);
+    return shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+}
+
+ShmState *shm_state_start(AppData *app)
+{
+    const char *name = g_getenv("PW_MIXER_SHM_NAME");
+    if (!name || !name[0])
+        return NULL;
+
+    char *shm_name = name[0] == '/' ? g_strdup(name) : g_strconcat("/", name, NULL);
+    int fd = shm_create(shm_name);
+    if (fd < 0 || ftruncate(fd, sizeof(MixerShmBlock)) < 0) {
+        fprintf(stderr, "[shm] cannot create %s: %s\n", shm_name, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(shm_name);
+        }
+        g_free(shm_name);
+        return NULL;
+    }
+
+    MixerShmBlock *block = mmap(NULL, sizeof(MixerShmBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED) {
+        fprintf(stderr, "[shm] cannot map %s: %s\n", shm_name, strerror(errno));
+        shm_unlink(shm_name);
+        g_free(shm_name);
+        return NULL;
+    }
+
+    /* Fresh generation; magic goes in last so attached readers re-validate */
+    __atomic_store_n(&block->magic, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->owner_pid, (uint32_t)getpid(), __ATOMIC_RELEASE);
+    memset(&block->targets, 0, sizeof(block->targets));
+    block->target_seq = 0;
+    block->state_seq = 0;
+    block->version = MIXER_SHM_VERSION;
+    block->size = sizeof(MixerShmBlock);
+    block->n_sources = MIXER_SHM_SOURCES;
+    __atomic_store_n(&block->magic, MIXER_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    ShmState *shm = g_new0(ShmState, 1);
+    shm->app = app;
+    shm->loop = pw_main_loop_get_loop(app->loop);
+    shm->name = shm_name;
+    shm->block = block;
+    shm->timer = pw_loop_add_timer(shm->loop, on_shm_tick, shm);
+
+    gint64 period = control_period_from_env();
+    struct timespec value = {period / G_USEC_PER_SEC, (long)(period % G_USEC_PER_SEC) * 1000};
+    if (shm->timer)
+        pw_loop_update_timer(shm->loop, shm->timer, &value, &value, false);
+
+    printf("[shm] state block %s (%zu bytes), control tick %lld us\n",
+           shm_name, sizeof(MixerShmBlock), (long long)period);
+    return shm;
+}
+
+void shm_state_stop(ShmState *shm)
+{
+    if (!shm)
+        return;
+
+    if (shm->timer)
+        pw_loop_destroy_source(shm->loop, shm->timer);
+    if (shm->reads_failed)
+        printf("[shm] %llu target reads overlapped a write and were retried on a later tick\n",
+               (unsigned long long)shm->reads_failed);
+
+    __atomic_store_n(&shm->block->magic, 0, __ATOMIC_RELEASE);
+    munmap(shm->block, sizeof(MixerShmBlock));
+    shm_unlink(shm->name);
+    g_free(shm->name);
+    g_free(shm);
+}
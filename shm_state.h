@@ -0,0 +1,15 @@
+#ifndef PW_MIXER_SHM_STATE_H
+#define PW_MIXER_SHM_STATE_H
+
+#include "app.h"
+
+/*
+ * Controller side of the shared-memory block (mixer_shm.h). Enabled when
+ * PW_MIXER_SHM_NAME is set; serviced by a timer on the PipeWire loop at
+ * the control rate.
+ */
+ShmState *shm_state_start(AppData *app);
+void shm_state_stop(ShmState *shm);
+void shm_state_publish(ShmState *shm);
+
+#endif /* PW_MIXER_SHM_STATE_H */
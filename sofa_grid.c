@@ -0,0 +1,191 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#ifdef HAVE_MYSOFA
+#include <mysofa.h>
+#endif
+#include "sofa_grid.h"
+
+#define DEG2RAD ((float)M_PI / 180.0f)
+
+SofaResolution sofa_resolution_from_env(void)
+{
+    const char *mode = g_getenv("PW_MIXER_SOFA_RESOLUTION");
+
+    if (mode && g_ascii_strcasecmp(mode, "exact") == 0)
+        return SOFA_RESOLUTION_EXACT;
+    return SOFA_RESOLUTION_GRID;
+}
+
+/* First `filename = "..."` in the installed filter-chain config */
+static char *find_file_in_config(const char *conf_path)
+{
+    gchar *contents = NULL;
+    char *result = NULL;
+
+    if (!g_file_get_contents(conf_path, &contents, NULL, NULL))
+        return NULL;
+
+    const char *p = strstr(contents, "filename");
+    if (p) {
+        const char *open = strchr(p, '"');
+        const char *close = open ? strchr(open + 1, '"') : NULL;
+        if (close && close > open + 1 && strncmp(open + 1, "@SOFA_FILE@", close - open - 1) != 0)
+            result = g_strndup(open + 1, close - open - 1);
+    }
+
+    g_free(contents);
+    return result;
+}
+
+/* Same lookup order as setup.sh: PW_MIXER_SOFA_FILE, then the rendered sp_2.conf */
+char *sofa_grid_find_file(void)
+{
+    const char *env = g_getenv("PW_MIXER_SOFA_FILE");
+    if (env && env[0])
+        return g_strdup(env);
+
+    const char *conf = g_getenv("PW_MIXER_CONFIG_FILE");
+    gchar *conf_path = (conf && conf[0])
+        ? g_strdup(conf)
+        : g_build_filename(g_get_user_config_dir(), "pipewire", "pipewire.conf.d", "sp_2.conf", NULL);
+
+    char *path = find_file_in_config(conf_path);
+    g_free(conf_path);
+    return path;
+}
+
+static int bucket_of(float elevation)
+{
+    int b = (int)floorf((elevation + 90.0f) / SOFA_GRID_BUCKET_DEG + 0.5f);
+    if (b < 0)
+        b = 0;
+    if (b >= SOFA_GRID_BUCKETS)
+        b = SOFA_GRID_BUCKETS - 1;
+    return b;
+}
+
+static void to_unit(float azimuth, float elevation, float *v)
+{
+    float az = azimuth * DEG2RAD;
+    float el = elevation * DEG2RAD;
+
+    v[0] = cosf(el) * cosf(az);
+    v[1] = cosf(el) * sinf(az);
+    v[2] = sinf(el);
+}
+
+/* Builds the buckets from n (azimuth, elevation) pairs in degrees */
+static void grid_build(SofaGrid *grid, const float *az_el, uint32_t n)
+{
+    uint32_t fill[SOFA_GRID_BUCKETS] = {0};
+
+    grid->xyz = g_new(float, (size_t)n * 3);
+    grid->order = g_new(uint32_t, n);
+    memset(grid->bucket_start, 0, sizeof(grid->bucket_start));
+
+    for (uint32_t i = 0; i < n; i++) {
+        to_unit(az_el[i * 2], az_el[i * 2 + 1], &grid->xyz[i * 3]);
+        grid->bucket_start[bucket_of(az_el[i * 2 + 1]) + 1]++;
+    }
+    for (int b = 0; b < SOFA_GRID_BUCKETS; b++)
+        grid->bucket_start[b + 1] += grid->bucket_start[b];
+    for (uint32_t i = 0; i < n; i++) {
+        int b = bucket_of(az_el[i * 2 + 1]);
+        grid->order[grid->bucket_start[b] + fill[b]++] = i;
+    }
+
+    grid->n_cells = n;
+}
+
+bool sofa_grid_load(SofaGrid *grid, const char *path)
+{
+    memset(grid, 0, sizeof(*grid));
+    if (!path)
+        return false;
+
+#ifdef HAVE_MYSOFA
+    int err = 0;
+    struct MYSOFA_HRTF *hrtf = mysofa_load(path, &err);
+    if (!hrtf || err != MYSOFA_OK) {
+        fprintf(stderr, "[sofa] cannot load %s (error %d)\n", path, err);
+        if (hrtf)
+            mysofa_free(hrtf);
+        return false;
+    }
+
+    mysofa_tospherical(hrtf);
+
+    uint32_t n = hrtf->M;
+    float *az_el = g_new(float, (size_t)n * 2);
+    for (uint32_t i = 0; i < n; i++) {
+        az_el[i * 2] = hrtf->SourcePosition.values[i * 3];
+        az_el[i * 2 + 1] = hrtf->SourcePosition.values[i * 3 + 1];
+    }
+    grid_build(grid, az_el, n);
+    g_free(az_el);
+    mysofa_free(hrtf);
+
+    printf("[sofa] %u measurement positions from %s\n", n, path);
+    return true;
+#else
+    printf("[sofa] built without libmysofa; cannot read the grid of %s\n", path);
+    return false;
+#endif
+}
+
+void sofa_grid_clear(SofaGrid *grid)
+{
+    g_free(grid->xyz);
+    g_free(grid->order);
+    memset(grid, 0, sizeof(*grid));
+}
+
+/*
+ * Index of the measurement closest in angle, -1 without a grid. Bands are
+ * visited outward from the query's own; the angle to any cell is at least
+ * the elevation gap to its band, which bounds the search.
+ */
+int sofa_grid_nearest(const SofaGrid *grid, float azimuth, float elevation)
+{
+    if (grid->n_cells == 0)
+        return -1;
+
+    float q[3];
+    to_unit(azimuth, elevation, q);
+
+    int home = bucket_of(elevation);
+    int best = -1;
+    float best_dot = -2.0f;
+
+    for (int d = 0; d < SOFA_GRID_BUCKETS; d++) {
+        bool visited = false;
+
+        /* The query sits within half a band of home, so bands home +- d are at least this far */
+        float gap = (d - 1) * SOFA_GRID_BUCKET_DEG;
+        if (best >= 0 && gap > 0.0f && cosf(gap * DEG2RAD) < best_dot)
+            break;
+
+        for (int side = -1; side <= 1; side += 2) {
+            int b = home + side * d;
+            if (b < 0 || b >= SOFA_GRID_BUCKETS || (d == 0 && side > 0))
+                continue;
+            visited = true;
+
+            for (uint32_t k = grid->bucket_start[b]; k < grid->bucket_start[b + 1]; k++) {
+                const float *v = &grid->xyz[grid->order[k] * 3];
+                float dot = v[0] * q[0] + v[1] * q[1] + v[2] * q[2];
+                if (dot > best_dot) {
+                    best_dot = dot;
+                    best = (int)grid->order[k];
+                }
+            }
+        }
+
+        if (!visited)
+            break;
+    }
+
+    return best;
+}
@@ -0,0 +1,37 @@
+#ifndef PW_MIXER_SOFA_GRID_H
+#define PW_MIXER_SOFA_GRID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SOFA_GRID_BUCKET_DEG 10.0f
+#define SOFA_GRID_BUCKETS 19     /* elevation -90..+90 in 10 degree bands */
+
+typedef enum {
+    SOFA_RESOLUTION_EXACT,      /* every control change beyond the deadband is sent */
+    SOFA_RESOLUTION_GRID,       /* azimuth/elevation only sent when the nearest HRIR changes */
+} SofaResolution;
+
+/*
+ * Measurement positions of the SOFA file the filter graph loads, bucketed
+ * by elevation so a nearest-cell lookup only visits nearby bands.
+ */
+typedef struct {
+    uint32_t n_cells;
+    float *xyz;                 /* unit vectors, 3 floats per cell */
+    uint32_t *order;            /* cell indices grouped by bucket */
+    uint32_t bucket_start[SOFA_GRID_BUCKETS + 1];
+} SofaGrid;
+
+SofaResolution sofa_resolution_from_env(void);
+char *sofa_grid_find_file(void);
+bool sofa_grid_load(SofaGrid *grid, const char *path);
+void sofa_grid_clear(SofaGrid *grid);
+int sofa_grid_nearest(const SofaGrid *grid, float azimuth, float elevation);
+
+static inline bool sofa_grid_loaded(const SofaGrid *grid)
+{
+    return grid->n_cells > 0;
+}
+
+#endif /* PW_MIXER_SOFA_GRID_H */
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "strpool.h"
+
+#define STRPOOL_CHUNK_SIZE 4096
+
+struct StrChunk {
+    StrChunk *next;       /* all chunks, for strpool_clear */
+    StrChunk *prev;
+    size_t size;
+    size_t used;
+    size_t live;          /* strings still referenced in this chunk */
+    char data[];
+};
+
+typedef struct {
+    StrChunk *chunk;
+    guint refs;
+    char str[];
+} StrEntry;
+
+static StrChunk *chunk_new(StrPool *pool, size_t size)
+{
+    StrChunk *c = g_malloc(sizeof(StrChunk) + size);
+    c->size = size;
+    c->used = 0;
+    c->live = 0;
+    c->prev = NULL;
+    c->next = pool->head;
+    if (c->next)
+        c->next->prev = c;
+    pool->head = c;
+    pool->chunks++;
+    return c;
+}
+
+static void chunk_free(StrPool *pool, StrChunk *c)
+{
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        pool->head = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+    pool->chunks--;
+    g_free(c);
+}
+
+static StrEntry *entry_of(const char *str)
+{
+    return (StrEntry *)(str - offsetof(StrEntry, str));
+}
+
+void strpool_init(StrPool *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->index = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+void strpool_clear(StrPool *pool)
+{
+    StrChunk *c = pool->head;
+    while (c) {
+        StrChunk *next = c->next;
+        g_free(c);
+        c = next;
+    }
+    if (pool->index)
+        g_hash_table_destroy(pool->index);
+    memset(pool, 0, sizeof(*pool));
+}
+
+const char *strpool_intern(StrPool *pool, const char *str)
+{
+    if (!str)
+        return NULL;
+
+    StrEntry *e = g_hash_table_lookup(pool->index, str);
+    if (e) {
+        e->refs++;
+        return e->str;
+    }
+
+    size_t need = (offsetof(StrEntry, str) + strlen(str) + 1 + 7) & ~(size_t)7;
+    StrChunk *c = pool->current;
+
+    if (need > STRPOOL_CHUNK_SIZE / 4) {
+        /* Oversized strings get a private chunk so they never pin a shared one */
+        c = chunk_new(pool, need);
+    } else if (!c || c->used + need > c->size) {
+        if (c && c->live == 0) {
+            c->used = 0;
+        } else {
+            c = chunk_new(pool, STRPOOL_CHUNK_SIZE);
+            pool->current = c;
+        }
+    }
+
+    e = (StrEntry *)(c->data + c->used);
+    c->used += need;
+    c->live++;
+    e->chunk = c;
+    e->refs = 1;
+    strcpy(e->str, str);
+
+    g_hash_table_insert(pool->index, e->str, e);
+    pool->live_strings++;
+    return e->str;
+}
+
+void strpool_release(StrPool *pool, const char *str)
+{
+    if (!str)
+        return;
+
+    StrEntry *e = entry_of(str);
+    if (--e->refs > 0)
+        return;
+
+    StrChunk *c = e->chunk;
+    g_hash_table_remove(pool->index, e->str);
+    pool->live_strings--;
+
+    if (--c->live > 0)
+        return;
+
+    if (c == pool->current)
+        c->used = 0;     /* keep the active chunk, start over at its beginning */
+    else
+        chunk_free(pool, c);
+}
@@ -0,0 +1,27 @@
+#ifndef PW_MIXER_STRPOOL_H
+#define PW_MIXER_STRPOOL_H
+
+#include <stddef.h>
+#include <glib.h>
+
+typedef struct StrChunk StrChunk;
+
+/*
+ * Reference-counted string interning backed by bump-allocated chunks.
+ * Equal strings share one copy; a chunk is returned to the heap once the
+ * last string living in it is released. Not thread-safe.
+ */
+typedef struct {
+    GHashTable *index;   /* key: interned string, value: StrEntry* */
+    StrChunk *head;      /* every allocated chunk */
+    StrChunk *current;   /* chunk new strings are appended to */
+    size_t chunks;
+    size_t live_strings;
+} StrPool;
+
+void strpool_init(StrPool *pool);
+void strpool_clear(StrPool *pool);
+const char *strpool_intern(StrPool *pool, const char *str);
+void strpool_release(StrPool *pool, const char *str);
+
+#endif /* PW_MIXER_STRPOOL_H */
@@ -1,9 +1,11 @@
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <gtk/gtk.h>
 #include "ui.h"
 #include "pipewire.h"
+#include "ui_mailbox.h"
 
 static const double COLORS[MAX_SOURCES][3] = {
     {0.2, 0.8, 0.9},  /* Cyan */
@@ -14,14 +16,87 @@ static const double COLORS[MAX_SOURCES][3] = {
 
 void refresh_canvas(AppData *data)
 {
-    if (data->canvas) {
-        gtk_widget_queue_draw(data->canvas);
+    if (data->ui && data->ui->canvas) {
+        gtk_widget_queue_draw(data->ui->canvas);
     }
 }
 
-static void stereo_positions(const AppData *data, int idx, double *out_lx, double *out_ly, double *out_rx, double *out_ry)
+/* Pushes pending source changes at most once per control period; uninstalls itself once idle */
+static gboolean on_input_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
 {
-    if (!data->sources[idx].active || !data->sources[idx].is_playing) {
+    (void)widget;
+    AppData *data = user_data;
+
+    if (!data->ui->input_dirty) {
+        data->ui->input_tick_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    gint64 now = gdk_frame_clock_get_frame_time(clock);
+    if (now - data->ui->input_last_push < data->ui->input_period_usec)
+        return G_SOURCE_CONTINUE;
+
+    guint dirty = data->ui->input_dirty;
+    data->ui->input_dirty = 0;
+    data->ui->input_last_push = now;
+    send_sofa_controls(data, dirty);
+
+    /* Stay installed one more period so a trailing change is still flushed */
+    return G_SOURCE_CONTINUE;
+}
+
+/* Input handlers only record the latest value; the tick callback sends it */
+static void queue_source_update(AppData *data, int source_idx)
+{
+    data->ui->input_dirty |= 1u << source_idx;
+    if (!data->ui->input_tick_id && data->ui->canvas)
+        data->ui->input_tick_id = gtk_widget_add_tick_callback(data->ui->canvas, on_input_tick, data, NULL);
+}
+
+/* Applies everything the PipeWire thread published since the last flush */
+static gboolean flush_ui_mailbox(gpointer user_data)
+{
+    AppData *data = user_data;
+    guint dirty[MAX_SOURCES];
+    UiSlotState slots[MAX_SOURCES];
+    bool canvas_dirty = false;
+
+    ui_mailbox_take(&data->mailbox, dirty, slots, &canvas_dirty);
+
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if ((dirty[i] & UI_DIRTY_PLAYING) && data->ui->playing_labels[i])
+            gtk_label_set_text(GTK_LABEL(data->ui->playing_labels[i]), slots[i].playing_text);
+        if ((dirty[i] & UI_DIRTY_SOURCE_LABEL) && data->ui->source_labels[i])
+            gtk_label_set_text(GTK_LABEL(data->ui->source_labels[i]), slots[i].source_text);
+        if (dirty[i] & UI_DIRTY_POSITION) {
+            /* The value-changed handlers see the same value and send nothing */
+            if (data->ui->elevation_sliders[i])
+                gtk_range_set_value(GTK_RANGE(data->ui->elevation_sliders[i]), slots[i].elevation);
+            if (data->ui->width_sliders[i])
+                gtk_range_set_value(GTK_RANGE(data->ui->width_sliders[i]), slots[i].width);
+        }
+        if (dirty[i] & UI_DIRTY_CANVAS)
+            data->ui->canvas_slots[i] = slots[i];
+        if (dirty[i] & UI_DIRTY_SENSITIVITY) {
+            if (data->ui->elevation_sliders[i])
+                gtk_widget_set_sensitive(data->ui->elevation_sliders[i], slots[i].sliders_sensitive);
+            if (data->ui->width_sliders[i])
+                gtk_widget_set_sensitive(data->ui->width_sliders[i], slots[i].sliders_sensitive);
+            if (data->ui->bypass_checkboxes[i])
+                gtk_widget_set_sensitive(data->ui->bypass_checkboxes[i], slots[i].bypass_sensitive);
+        }
+    }
+
+    if (canvas_dirty)
+        refresh_canvas(data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void stereo_positions(AppData *data, int idx, double *out_lx, double *out_ly, double *out_rx, double *out_ry)
+{
+    const UiSlotState *slot = &data->ui->canvas_slots[idx];
+    if (!slot->active || !slot->playing) {
         if (out_lx) *out_lx = 0;
         if (out_ly) *out_ly = 0;
         if (out_rx) *out_rx = 0;
@@ -29,15 +104,18 @@ static void stereo_positions(const AppData *data, int idx, double *out_lx, doubl
         return;
     }
 
+    g_mutex_lock(&data->positions_lock);
     float center = data->sources[idx].azimuth;
     float half = data->sources[idx].width * 0.5f;
+    float radius_pct = data->sources[idx].radius / 100.0f;
+    g_mutex_unlock(&data->positions_lock);
+
     float az_l = center - half;
     float az_r = center + half;
 
     if (az_l < 0.0f) az_l += 360.0f;
     if (az_r >= 360.0f) az_r -= 360.0f;
 
-    float radius_pct = data->sources[idx].radius / 100.0f;
     float radius_px = radius_pct * MAX_RADIUS;
 
     float angle_l = (az_l - 90.0f) * M_PI / 180.0f;
@@ -54,7 +132,7 @@ static int find_source_at_point(AppData *data, double x, double y)
     const double grab_radius = 14.0;
     for (int i = 0; i < MAX_SOURCES; i++) {
         double lx = 0, ly = 0, rx = 0, ry = 0;
-        if (!data->sources[i].active || !data->sources[i].is_playing)
+        if (!data->ui->canvas_slots[i].active || !data->ui->canvas_slots[i].playing)
             continue;
 
         stereo_positions(data, i, &lx, &ly, &rx, &ry);
@@ -129,7 +207,7 @@ static void draw_canvas(GtkDrawingArea *area, cairo_t *cr, int width, int height
     cairo_fill(cr);
 
     for (int i = 0; i < MAX_SOURCES; i++) {
-        if (!data->sources[i].active || !data->sources[i].is_playing)
+        if (!data->ui->canvas_slots[i].active || !data->ui->canvas_slots[i].playing)
             continue;
 
         double lx=0, ly=0, rx=0, ry=0;
@@ -144,10 +222,13 @@ static void draw_canvas(GtkDrawingArea *area, cairo_t *cr, int width, int height
         cairo_stroke(cr);
 
         /* Draw L/R markers; if width is 0 they overlap */
+        g_mutex_lock(&data->positions_lock);
         float elev = data->sources[i].elevation;
+        g_mutex_unlock(&data->positions_lock);
         double bright = 0.55 + ((elev + 90.0) / 180.0) * 0.45; /* 0.55..1.0 */
         double radius = 10.5 + (elev / 90.0) * 2.0;            /* +/-2 px */
-        const char *label = (data->sources[i].app_label[0] != '\0') ? data->sources[i].app_label : "SPK";
+        const char *app_label = data->ui->canvas_slots[i].app_label;
+        const char *label = (app_label[0] != '\0') ? app_label : "SPK";
 
         cairo_set_source_rgb(cr,
             COLORS[i][0] * bright,
@@ -234,9 +315,16 @@ static void on_elevation_changed(GtkRange *range, gpointer user_data)
     AppData *data = g_object_get_data(G_OBJECT(range), "app_data");
 
     float elevation = gtk_range_get_value(range);
-    data->sources[source_idx].elevation = elevation;
+    /* Within slider rounding of the held value, e.g. the echo of a remote update */
+    g_mutex_lock(&data->positions_lock);
+    bool same = fabsf(elevation - data->sources[source_idx].elevation) < 0.2f;
+    if (!same)
+        data->sources[source_idx].elevation = elevation;
+    g_mutex_unlock(&data->positions_lock);
+    if (same)
+        return;
 
-    send_sofa_control(data, source_idx);
+    queue_source_update(data, source_idx);
     refresh_canvas(data);
 }
 
@@ -246,12 +334,15 @@ static void on_width_changed(GtkRange *range, gpointer user_data)
     AppData *data = g_object_get_data(G_OBJECT(range), "app_data");
 
     float width = gtk_range_get_value(range);
-    if (fabsf(width - data->sources[source_idx].width) < 0.2f)
+    g_mutex_lock(&data->positions_lock);
+    bool same = fabsf(width - data->sources[source_idx].width) < 0.2f;
+    if (!same)
+        data->sources[source_idx].width = width;
+    g_mutex_unlock(&data->positions_lock);
+    if (same)
         return;
 
-    data->sources[source_idx].width = width;
-
-    send_sofa_control(data, source_idx);
+    queue_source_update(data, source_idx);
     refresh_canvas(data);
 }
 
@@ -266,10 +357,12 @@ void update_source_position(AppData *data, int source_idx, float azimuth, float
 {
     if (source_idx < 0 || source_idx >= MAX_SOURCES) return;
 
+    g_mutex_lock(&data->positions_lock);
     data->sources[source_idx].azimuth = azimuth;
     data->sources[source_idx].radius = radius;
+    g_mutex_unlock(&data->positions_lock);
 
-    send_sofa_control(data, source_idx);
+    queue_source_update(data, source_idx);
     refresh_canvas(data);
 }
 
@@ -278,18 +371,18 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
     GtkWidget *source_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 3);
     gtk_widget_set_margin_top(source_box, 5);
     gtk_widget_set_margin_bottom(source_box, 5);
-    data->source_boxes[idx] = source_box;
+    data->ui->source_boxes[idx] = source_box;
 
     GtkWidget *header_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     gtk_box_append(GTK_BOX(source_box), header_box);
 
     char label_text[64];
     snprintf(label_text, sizeof(label_text), "Source %d (%s)", idx + 1, source_name);
-    data->source_labels[idx] = gtk_label_new(label_text);
-    gtk_widget_set_halign(data->source_labels[idx], GTK_ALIGN_START);
-    gtk_label_set_ellipsize(GTK_LABEL(data->source_labels[idx]), PANGO_ELLIPSIZE_END);
-    gtk_widget_set_size_request(data->source_labels[idx], 200, -1);
-    gtk_box_append(GTK_BOX(header_box), data->source_labels[idx]);
+    data->ui->source_labels[idx] = gtk_label_new(label_text);
+    gtk_widget_set_halign(data->ui->source_labels[idx], GTK_ALIGN_START);
+    gtk_label_set_ellipsize(GTK_LABEL(data->ui->source_labels[idx]), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_size_request(data->ui->source_labels[idx], 200, -1);
+    gtk_box_append(GTK_BOX(header_box), data->ui->source_labels[idx]);
 
     GtkWidget *elev_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     GtkWidget *elev_label = gtk_label_new("Elevation:");
@@ -301,7 +394,7 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
     gtk_scale_set_value_pos(GTK_SCALE(elev_slider), GTK_POS_RIGHT);
     g_object_set_data(G_OBJECT(elev_slider), "app_data", data);
     g_signal_connect(elev_slider, "value-changed", G_CALLBACK(on_elevation_changed), GINT_TO_POINTER(idx));
-    data->elevation_sliders[idx] = elev_slider;
+    data->ui->elevation_sliders[idx] = elev_slider;
     gtk_widget_set_sensitive(elev_slider, false);
     gtk_box_append(GTK_BOX(elev_box), elev_slider);
 
@@ -317,7 +410,7 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
     gtk_scale_set_value_pos(GTK_SCALE(width_slider), GTK_POS_RIGHT);
     g_object_set_data(G_OBJECT(width_slider), "app_data", data);
     g_signal_connect(width_slider, "value-changed", G_CALLBACK(on_width_changed), GINT_TO_POINTER(idx));
-    data->width_sliders[idx] = width_slider;
+    data->ui->width_sliders[idx] = width_slider;
     gtk_widget_set_sensitive(width_slider, false);
     gtk_box_append(GTK_BOX(width_box), width_slider);
 
@@ -325,9 +418,9 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
 
     GtkWidget *bypass_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     GtkWidget *bypass_check = gtk_check_button_new_with_label("Bypass");
-    /* Keep bypass usable for active slots even when no stream is currently playing. */
-    gtk_widget_set_sensitive(bypass_check, data->sources[idx].active);
-    data->bypass_checkboxes[idx] = bypass_check;
+    /* Enabled by the mailbox once the slot is active, even with no stream playing */
+    gtk_widget_set_sensitive(bypass_check, false);
+    data->ui->bypass_checkboxes[idx] = bypass_check;
     g_object_set_data(G_OBJECT(bypass_check), "app_data", data);
     g_signal_connect(bypass_check, "toggled", G_CALLBACK(on_bypass_toggled), GINT_TO_POINTER(idx));
     gtk_box_append(GTK_BOX(bypass_box), bypass_check);
@@ -335,7 +428,7 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
 
     GtkWidget *playing_label = gtk_label_new("No audio");
     gtk_widget_set_halign(playing_label, GTK_ALIGN_START);
-    data->playing_labels[idx] = playing_label;
+    data->ui->playing_labels[idx] = playing_label;
     gtk_box_append(GTK_BOX(source_box), playing_label);
 
     GtkWidget *separator = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
@@ -346,12 +439,13 @@ static GtkWidget *build_source_control(AppData *data, int idx, const char *sourc
 
 void build_gui(AppData *data)
 {
-    data->window = gtk_application_window_new(GTK_APPLICATION(g_application_get_default()));
-    gtk_window_set_title(GTK_WINDOW(data->window), "PipeWire 3D Audio Mixer (4-Channel)");
-    gtk_window_set_default_size(GTK_WINDOW(data->window), 900, 550);
+    data->ui = g_new0(UiWidgets, 1);
+    data->ui->window = gtk_application_window_new(GTK_APPLICATION(g_application_get_default()));
+    gtk_window_set_title(GTK_WINDOW(data->ui->window), "PipeWire 3D Audio Mixer (4-Channel)");
+    gtk_window_set_default_size(GTK_WINDOW(data->ui->window), 900, 550);
 
     GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-    gtk_window_set_child(GTK_WINDOW(data->window), main_box);
+    gtk_window_set_child(GTK_WINDOW(data->ui->window), main_box);
     gtk_widget_set_margin_start(main_box, 10);
     gtk_widget_set_margin_end(main_box, 10);
     gtk_widget_set_margin_top(main_box, 10);
@@ -361,22 +455,22 @@ void build_gui(AppData *data)
     gtk_widget_set_size_request(canvas_frame, CANVAS_SIZE + 20, CANVAS_SIZE + 20);
     gtk_widget_set_valign(canvas_frame, GTK_ALIGN_CENTER);
 
-    data->canvas = gtk_drawing_area_new();
-    gtk_widget_set_size_request(data->canvas, CANVAS_SIZE, CANVAS_SIZE);
-    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(data->canvas), draw_canvas, data, NULL);
-    gtk_frame_set_child(GTK_FRAME(canvas_frame), data->canvas);
+    data->ui->canvas = gtk_drawing_area_new();
+    gtk_widget_set_size_request(data->ui->canvas, CANVAS_SIZE, CANVAS_SIZE);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(data->ui->canvas), draw_canvas, data, NULL);
+    gtk_frame_set_child(GTK_FRAME(canvas_frame), data->ui->canvas);
 
     GtkGesture *click = gtk_gesture_click_new();
     gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(click), GDK_BUTTON_PRIMARY);
     g_signal_connect(click, "pressed", G_CALLBACK(on_canvas_click), data);
-    gtk_widget_add_controller(data->canvas, GTK_EVENT_CONTROLLER(click));
+    gtk_widget_add_controller(data->ui->canvas, GTK_EVENT_CONTROLLER(click));
 
     GtkGesture *drag = gtk_gesture_drag_new();
     g_signal_connect(drag, "drag-begin", G_CALLBACK(on_drag_begin), data);
     g_signal_connect(drag, "drag-update", G_CALLBACK(on_drag_update), data);
     g_signal_connect(drag, "drag-end", G_CALLBACK(on_drag_end), data);
     g_object_set_data(G_OBJECT(drag), "dragging-source", GINT_TO_POINTER(-1));
-    gtk_widget_add_controller(data->canvas, GTK_EVENT_CONTROLLER(drag));
+    gtk_widget_add_controller(data->ui->canvas, GTK_EVENT_CONTROLLER(drag));
 
     gtk_box_append(GTK_BOX(main_box), canvas_frame);
 
@@ -398,4 +492,7 @@ void build_gui(AppData *data)
     g_object_set_data(G_OBJECT(kill_links_btn), "app_data", data);
     g_signal_connect_swapped(kill_links_btn, "clicked", G_CALLBACK(unlink_all_filter_inputs), data);
     gtk_box_append(GTK_BOX(control_box), kill_links_btn);
+
+    data->ui->input_period_usec = control_period_from_env();
+    ui_mailbox_attach(&data->mailbox, flush_ui_mailbox, data);
 }
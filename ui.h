@@ -1,8 +1,30 @@
 #ifndef PW_MIXER_UI_H
 #define PW_MIXER_UI_H
 
+#include <gtk/gtk.h>
 #include "app.h"
 
+/* GTK side of AppData, allocated by build_gui() (GTK thread only) */
+struct UiWidgets {
+    GtkWidget *window;
+    GtkWidget *canvas;
+    GtkWidget *source_boxes[MAX_SOURCES];
+    GtkWidget *elevation_sliders[MAX_SOURCES];
+    GtkWidget *width_sliders[MAX_SOURCES];
+    GtkWidget *bypass_checkboxes[MAX_SOURCES];
+    GtkWidget *playing_labels[MAX_SOURCES];
+    GtkWidget *source_labels[MAX_SOURCES];
+
+    /* Slot state the canvas draws, copied from the mailbox on each flush */
+    UiSlotState canvas_slots[MAX_SOURCES];
+
+    /* Pointer/slider input: latest values live in sources[], pushed by a canvas tick callback */
+    guint input_dirty;          /* bit per source changed since the last push */
+    guint input_tick_id;        /* 0 when no tick callback is installed */
+    gint64 input_period_usec;   /* 1 / PW_MIXER_CONTROL_RATE_HZ */
+    gint64 input_last_push;
+};
+
 void build_gui(AppData *data);
 void update_source_position(AppData *data, int source_idx, float azimuth, float radius);
 void refresh_canvas(AppData *data);
@@ -0,0 +1,125 @@
+#include <string.h>
+#include "ui_mailbox.h"
+
+static void schedule_flush(UiMailbox *mb)
+{
+    GSourceFunc flush = g_atomic_pointer_get(&mb->flush);
+    if (!flush)
+        return;
+
+    /* One pending idle per burst; the flush callback re-arms it */
+    if (g_atomic_int_compare_and_exchange(&mb->scheduled, 0, 1))
+        g_idle_add(flush, mb->flush_data);
+}
+
+void ui_mailbox_init(UiMailbox *mb)
+{
+    memset(mb, 0, sizeof(*mb));
+    g_mutex_init(&mb->lock);
+}
+
+void ui_mailbox_clear(UiMailbox *mb)
+{
+    g_mutex_clear(&mb->lock);
+}
+
+void ui_mailbox_set_playing(UiMailbox *mb, int slot, const char *text)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    g_mutex_lock(&mb->lock);
+    g_strlcpy(mb->slots[slot].playing_text, text ? text : "",
+              sizeof(mb->slots[slot].playing_text));
+    mb->dirty[slot] |= UI_DIRTY_PLAYING;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+void ui_mailbox_set_source_label(UiMailbox *mb, int slot, const char *text)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    g_mutex_lock(&mb->lock);
+    g_strlcpy(mb->slots[slot].source_text, text ? text : "",
+              sizeof(mb->slots[slot].source_text));
+    mb->dirty[slot] |= UI_DIRTY_SOURCE_LABEL;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+void ui_mailbox_set_sensitivity(UiMailbox *mb, int slot, bool sliders, bool bypass)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    g_mutex_lock(&mb->lock);
+    mb->slots[slot].sliders_sensitive = sliders;
+    mb->slots[slot].bypass_sensitive = bypass;
+    mb->dirty[slot] |= UI_DIRTY_SENSITIVITY;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+void ui_mailbox_set_position(UiMailbox *mb, int slot, float elevation, float width)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    g_mutex_lock(&mb->lock);
+    mb->slots[slot].elevation = elevation;
+    mb->slots[slot].width = width;
+    mb->dirty[slot] |= UI_DIRTY_POSITION;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+/* Also redraws the canvas, which draws from this state */
+void ui_mailbox_set_canvas_slot(UiMailbox *mb, int slot, bool active, bool playing,
+                                const char *app_label)
+{
+    if (slot < 0 || slot >= MAX_SOURCES)
+        return;
+
+    g_mutex_lock(&mb->lock);
+    mb->slots[slot].active = active;
+    mb->slots[slot].playing = playing;
+    g_strlcpy(mb->slots[slot].app_label, app_label ? app_label : "",
+              sizeof(mb->slots[slot].app_label));
+    mb->dirty[slot] |= UI_DIRTY_CANVAS;
+    mb->canvas_dirty = true;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+void ui_mailbox_queue_redraw(UiMailbox *mb)
+{
+    g_mutex_lock(&mb->lock);
+    mb->canvas_dirty = true;
+    g_mutex_unlock(&mb->lock);
+    schedule_flush(mb);
+}
+
+void ui_mailbox_attach(UiMailbox *mb, GSourceFunc flush, gpointer flush_data)
+{
+    mb->flush_data = flush_data;
+    g_atomic_pointer_set(&mb->flush, flush);
+    /* Deliver anything published before the UI existed */
+    schedule_flush(mb);
+}
+
+void ui_mailbox_take(UiMailbox *mb, guint dirty[MAX_SOURCES], UiSlotState slots[MAX_SOURCES],
+                     bool *canvas_dirty)
+{
+    /* Clear first so publishes racing with this flush schedule another one */
+    g_atomic_int_set(&mb->scheduled, 0);
+
+    g_mutex_lock(&mb->lock);
+    memcpy(dirty, mb->dirty, sizeof(mb->dirty));
+    memcpy(slots, mb->slots, sizeof(mb->slots));
+    *canvas_dirty = mb->canvas_dirty;
+    memset(mb->dirty, 0, sizeof(mb->dirty));
+    mb->canvas_dirty = false;
+    g_mutex_unlock(&mb->lock);
+}
@@ -0,0 +1,28 @@
+#ifndef PW_MIXER_UI_MAILBOX_H
+#define PW_MIXER_UI_MAILBOX_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include "app.h"
+
+/*
+ * Publishing side, safe to call from the PipeWire thread. Changes are
+ * merged into per-slot state and applied by one idle callback on the GTK
+ * thread, however many arrive before it runs.
+ */
+void ui_mailbox_init(UiMailbox *mb);
+void ui_mailbox_clear(UiMailbox *mb);
+void ui_mailbox_set_playing(UiMailbox *mb, int slot, const char *text);
+void ui_mailbox_set_source_label(UiMailbox *mb, int slot, const char *text);
+void ui_mailbox_set_sensitivity(UiMailbox *mb, int slot, bool sliders, bool bypass);
+void ui_mailbox_set_position(UiMailbox *mb, int slot, float elevation, float width);
+void ui_mailbox_set_canvas_slot(UiMailbox *mb, int slot, bool active, bool playing,
+                                const char *app_label);
+void ui_mailbox_queue_redraw(UiMailbox *mb);
+
+/* Consuming side: the GTK thread installs its flush callback once */
+void ui_mailbox_attach(UiMailbox *mb, GSourceFunc flush, gpointer flush_data);
+void ui_mailbox_take(UiMailbox *mb, guint dirty[MAX_SOURCES], UiSlotState slots[MAX_SOURCES],
+                     bool *canvas_dirty);
+
+#endif /* PW_MIXER_UI_MAILBOX_H */